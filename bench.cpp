@@ -0,0 +1,494 @@
+//
+// HTML Lexer - Benchmark
+// Time tokenize, queries and print() per file, report CSV or JSON
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "html_lexer.hpp"
+#include "html_writer.hpp"
+
+// benchmark phases
+enum phase_type
+{
+    phase_tokenize,
+    phase_queries,
+    phase_print,
+    phase_count
+};
+
+static const char *phase_names[phase_count] = {"tokenize", "queries", "print"};
+
+// tag names of queries, each start tag found is matched too
+static const char *query_names[] = {"a", "div", "span", "li", "script"};
+
+// synthetic documents of pathological pages
+enum pattern_type
+{
+    pattern_script,     // "</s" fragments in a script
+    pattern_nested,     // same-name tags nested as deep as the document
+    pattern_attributes, // a tag with a huge attribute list
+    pattern_comment,    // an unterminated comment
+    pattern_count
+};
+
+static const char *pattern_names[pattern_count] =
+    {"script", "nested", "attributes", "comment"};
+
+// phases of the scaling benchmark
+enum scaling_phase_type
+{
+    scaling_tokenize,   // state machine engine
+    scaling_structural, // structural engine
+    scaling_push,       // push mode, 4KB chunks
+    scaling_queries,
+    scaling_phase_count
+};
+
+static const char *scaling_phase_names[scaling_phase_count] =
+    {"tokenize", "structural", "push", "queries"};
+
+// times of a phase of a file
+struct phase_result
+{
+    std::vector<double> seconds; // an element per iteration, sorted
+
+    double min() const {return seconds.front();}
+    double median() const {return seconds[seconds.size() / 2];}
+
+    // median of at least a tick of the clock, so rates of a phase faster
+    // than the clock are finite
+    double rate_median() const
+    {
+        using namespace std::chrono;
+        return std::max(median(),
+                        duration<double>(steady_clock::duration(1)).count());
+    }
+
+    // nearest rank
+    double p99() const
+    {
+        size_t rank = (seconds.size() * 99 + 99) / 100;
+        return seconds[rank - 1];
+    }
+};
+
+// quote a string for json, file names may have '\\' or '"'
+static std::string json_string(const char *str)
+{
+    std::string quoted = "\"";
+    for (; *str != '\0'; ++str)
+    {
+        if (*str == '"' || *str == '\\') quoted += '\\';
+        quoted += *str;
+    }
+
+    return quoted + '"';
+}
+
+// the tag and classes of the first start tag with class attribute, the
+// class query of a file
+static void find_class_query(const html_lexer &lexer, std::string &tag_name,
+                             std::string &classes)
+{
+    for (size_t pos = 0; pos < lexer.size(); ++pos)
+    {
+        html_token token = lexer.get_token(pos);
+        if (token->get_type() != html_token::token_start_tag) continue;
+
+        for (size_t i = 0; i < token->get_attribute_count(); ++i)
+        {
+            auto attribute = token->get_attribute(i);
+            if (html_iequals(attribute.first, "class") &&
+                attribute.second.find_first_not_of(" \n\r\t") !=
+                std::string_view::npos)
+            {
+                tag_name = token->get_name();
+                classes  = std::string(attribute.second);
+                return;
+            }
+        }
+    }
+}
+
+// run queries, return the number of results so the work is not optimized out
+static size_t run_queries(const html_lexer &lexer, const std::string &tag_name,
+                          const std::string &classes)
+{
+    size_t results = 0;
+
+    for (auto name : query_names)
+    {
+        for (size_t pos = lexer.find_tag_by_name(name, true, 0);
+             pos != html_lexer::npos;
+             pos = lexer.find_tag_by_name(name, true, pos + 1))
+        {
+            results += lexer.find_matching_tag(pos) != pos;
+        }
+    }
+
+    if (!tag_name.empty())
+    {
+        for (size_t pos = lexer.find_tag_by_class_names(tag_name, classes, 0);
+             pos != html_lexer::npos;
+             pos = lexer.find_tag_by_class_names(tag_name, classes, pos + 1))
+        {
+            ++results;
+        }
+    }
+
+    return results;
+}
+
+// generate a document of a pattern of about size bytes
+static void generate(pattern_type pattern, size_t size, std::string &html)
+{
+    html.clear();
+
+    switch (pattern)
+    {
+    case pattern_script:
+        html += "<html><body><script>";
+        for (size_t i = 0; html.size() < size; ++i)
+        {
+            html += "if (a</s) b = '</scr' + 'ipt>' + " +
+                    std::to_string(i) + ";\n";
+        }
+        html += "</script></body></html>";
+        break;
+    case pattern_nested:
+    {
+        // <div class="a"> and </div> are 21 bytes
+        size_t depth = size / 21;
+        for (size_t i = 0; i < depth; ++i)
+        {
+            html += "<div class=\"a\">";
+        }
+        for (size_t i = 0; i < depth; ++i)
+        {
+            html += "</div>";
+        }
+        break;
+    }
+    case pattern_attributes:
+        html += "<div";
+        for (size_t i = 0; html.size() < size; ++i)
+        {
+            // unknown names are interned
+            std::string n = std::to_string(i);
+            html += " data-a" + n + "=\"" + n + "\"";
+        }
+        html += "></div>";
+        break;
+    case pattern_comment:
+        html += "<p><!-- ";
+        while (html.size() < size)
+        {
+            html += "text <p> -- > <!-- <a href='x'> --!> ";
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// time phases of a file, the tables built by warmup iterations are reused,
+// so page faults of the first run are not measured
+static void run_file(std::string_view html, int warmup, int iterations,
+                     phase_result results[phase_count], size_t &tokens,
+                     size_t &query_results)
+{
+    using namespace std::chrono;
+
+    html_lexer lexer;
+    lexer.tokenize_view(html);
+
+    std::string tag_name, classes;
+    find_class_query(lexer, tag_name, classes);
+
+    // print() formats into the buffer of a writer without output
+    html_token_writer output(html_token_writer::no_fd);
+
+    for (int i = 0; i < warmup + iterations; ++i)
+    {
+        auto start = steady_clock::now();
+        lexer.tokenize_view(html);
+        auto tokenized = steady_clock::now();
+        query_results = run_queries(lexer, tag_name, classes);
+        auto queried = steady_clock::now();
+        output.write(lexer.get_store());
+        auto printed = steady_clock::now();
+
+        output.clear();
+
+        if (i < warmup) continue;
+
+        results[phase_tokenize].seconds.push_back(
+            duration<double>(tokenized - start).count());
+        results[phase_queries].seconds.push_back(
+            duration<double>(queried - tokenized).count());
+        results[phase_print].seconds.push_back(
+            duration<double>(printed - queried).count());
+    }
+
+    for (int phase = 0; phase < phase_count; ++phase)
+    {
+        std::sort(results[phase].seconds.begin(),
+                  results[phase].seconds.end());
+    }
+
+    tokens = lexer.size();
+}
+
+// time a phase of a synthetic document, return the minimum seconds
+static double time_scaling_phase(scaling_phase_type phase,
+                                 const std::string &html, int iterations,
+                                 size_t &tokens)
+{
+    using namespace std::chrono;
+
+    html_lexer lexer;
+    lexer.set_engine(phase == scaling_structural ?
+                     html_lexer::engine_structural :
+                     html_lexer::engine_state_machine);
+    lexer.set_token_handler([&](const html_token &) {++tokens;});
+
+    double best = 0;
+    for (int i = 0; i < iterations; ++i)
+    {
+        lexer.tokenize_view(html);
+        tokens = lexer.size();
+
+        auto start = steady_clock::now();
+        if (phase == scaling_push)
+        {
+            // the handler counts tokens
+            tokens = 0;
+            for (size_t pos = 0; pos < html.size(); pos += 4096)
+            {
+                lexer.feed(html.data() + pos,
+                           std::min<size_t>(4096, html.size() - pos));
+            }
+            lexer.finish();
+        }
+        else if (phase == scaling_queries)
+        {
+            run_queries(lexer, "div", "a");
+        }
+        else
+        {
+            lexer.tokenize_view(html);
+        }
+        double seconds = duration<double>(steady_clock::now() - start).count();
+
+        if (i == 0 || seconds < best) best = seconds;
+    }
+
+    return best;
+}
+
+// time each pattern at doubling sizes, report time per byte and growth,
+// the exponent of time against size since the smallest size, which is
+// about 1 if time is linear
+static void run_scaling(size_t min_size, size_t max_size, int iterations)
+{
+    using namespace std;
+
+    cout << "pattern,phase,bytes,tokens,min_us,ns_per_byte,growth\n";
+
+    string html;
+    for (int pattern = 0; pattern < pattern_count; ++pattern)
+    {
+        double first_seconds[scaling_phase_count] = {0};
+        size_t first_size = 0;
+
+        for (size_t size = min_size; size <= max_size; size *= 2)
+        {
+            generate((pattern_type)pattern, size, html);
+
+            for (int phase = 0; phase < scaling_phase_count; ++phase)
+            {
+                size_t tokens = 0;
+                double seconds = time_scaling_phase((scaling_phase_type)phase,
+                                                    html, iterations, tokens);
+                if (first_size == 0) first_seconds[phase] = seconds;
+
+                double growth = first_size == 0 ? 1 :
+                    log(seconds / first_seconds[phase]) /
+                    log((double)html.size() / first_size);
+
+                ostringstream row;
+                row.precision(3);
+                row << fixed << pattern_names[pattern] << ','
+                    << scaling_phase_names[phase] << ',' << html.size() << ','
+                    << tokens << ',' << seconds * 1e6 << ','
+                    << seconds * 1e9 / html.size() << ',' << growth << '\n';
+                cout << row.str();
+
+                // cache misses grow a little with size, quadratic time
+                // has a growth of 2
+                if (size * 2 > max_size && growth > 1.25)
+                {
+                    cerr << pattern_names[pattern] << " "
+                         << scaling_phase_names[phase] << ": super-linear, "
+                         << "growth " << growth << "\n";
+                }
+            }
+
+            if (first_size == 0) first_size = html.size();
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    using namespace std;
+
+    int  warmup     = 10;
+    int  iterations = 100;
+    bool json       = false;
+    int  first      = 1;
+
+    // write a synthetic document
+    if (argc == 4 && strcmp(argv[1], "-g") == 0)
+    {
+        for (int pattern = 0; pattern < pattern_count; ++pattern)
+        {
+            if (strcmp(argv[2], pattern_names[pattern]) == 0)
+            {
+                string html;
+                generate((pattern_type)pattern, strtoul(argv[3], nullptr, 10),
+                         html);
+                cout << html;
+                return 0;
+            }
+        }
+    }
+
+    // time synthetic documents from 64KB to max_size
+    if (argc >= 2 && strcmp(argv[1], "-s") == 0)
+    {
+        size_t max_size = argc >= 3 ? strtoul(argv[2], nullptr, 10) :
+                                      4 * 1024 * 1024;
+        run_scaling(64 * 1024, max_size, 5);
+        return 0;
+    }
+
+    for (; first < argc && argv[first][0] == '-'; ++first)
+    {
+        if (strcmp(argv[first], "-w") == 0 && first + 1 < argc)
+        {
+            warmup = atoi(argv[++first]);
+        }
+        else if (strcmp(argv[first], "-i") == 0 && first + 1 < argc)
+        {
+            iterations = atoi(argv[++first]);
+        }
+        else if (strcmp(argv[first], "-f") == 0 && first + 1 < argc)
+        {
+            json = strcmp(argv[++first], "json") == 0;
+        }
+        else
+        {
+            first = argc;
+        }
+    }
+
+    if (first >= argc || warmup < 0 || iterations <= 0)
+    {
+        cerr << "Usage: " << argv[0] << " [-w warmup] [-i iterations]"
+             << " [-f csv|json] filename.html...\n"
+             << "       " << argv[0] << " -s [max_size]"
+             << "  time synthetic documents of doubling sizes\n"
+             << "       " << argv[0] << " -g script|nested|attributes|comment"
+             << " size  write a synthetic document" << endl;
+        return 1;
+    }
+
+    // times are in microseconds, rates are of the median time, at least a
+    // tick of the clock
+    if (json)
+    {
+        cout << "[";
+    }
+    else
+    {
+        cout << "file,phase,bytes,tokens,iterations,"
+             << "min_us,median_us,p99_us,mb_per_s,tokens_per_s\n";
+    }
+
+    bool first_row = true;
+
+    for (int f = first; f < argc; ++f)
+    {
+        // mapped as by tokenize_file(), pipes are read
+        html_mapped_file file;
+        if (!file.open(argv[f], html_mapped_file::advice_sequential))
+        {
+            cerr << "Failed to open file: " << argv[f] << endl;
+            continue;
+        }
+        string_view html = file.view();
+
+        phase_result results[phase_count];
+        size_t tokens, query_results;
+        run_file(html, warmup, iterations, results, tokens, query_results);
+
+        for (int phase = 0; phase < phase_count; ++phase)
+        {
+            const phase_result &result = results[phase];
+            double median = result.median();
+            double rate_median = result.rate_median();
+
+            ostringstream row;
+            row.precision(3);
+            row << fixed;
+
+            if (json)
+            {
+                row << (first_row ? "\n" : ",\n")
+                    << "  {\"file\": " << json_string(argv[f]) << ", "
+                    << "\"phase\": \"" << phase_names[phase] << "\", "
+                    << "\"bytes\": " << html.size() << ", "
+                    << "\"tokens\": " << tokens << ", "
+                    << "\"iterations\": " << iterations << ", "
+                    << "\"min_us\": " << result.min() * 1e6 << ", "
+                    << "\"median_us\": " << median * 1e6 << ", "
+                    << "\"p99_us\": " << result.p99() * 1e6 << ", "
+                    << "\"mb_per_s\": "
+                    << html.size() / rate_median / 1e6 << ", "
+                    << "\"tokens_per_s\": " << tokens / rate_median << "}";
+            }
+            else
+            {
+                row << argv[f] << ',' << phase_names[phase] << ','
+                    << html.size() << ',' << tokens << ',' << iterations << ','
+                    << result.min() * 1e6 << ',' << median * 1e6 << ','
+                    << result.p99() * 1e6 << ','
+                    << html.size() / rate_median / 1e6 << ','
+                    << tokens / rate_median << '\n';
+            }
+
+            cout << row.str();
+            first_row = false;
+        }
+
+        // the results keep queries from being optimized out
+        cerr << argv[f] << ": " << query_results << " query results\n";
+    }
+
+    if (json)
+    {
+        cout << "\n]\n";
+    }
+
+    return 0;
+}
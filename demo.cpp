@@ -1,42 +1,860 @@
 #include <iostream>
 #include <fstream>
+#include <cstring>
+#include <cstdlib>
+#include <chrono>
+#include <iomanip>
+#include <thread>
+#include <filesystem>
 #include "html_lexer.hpp"
+#include "html_document_cache.hpp"
+#include "html_lexer_pool.hpp"
+#include "html_token_cache.hpp"
+#include "html_writer.hpp"
 #include "stopwatch.hpp"
 
+// read file content, return false if failed. the file is mapped as by
+// tokenize_file(), or read if it is a pipe, and copied to html.
+static bool read_file(const char *filename, std::string &html)
+{
+    html_mapped_file file;
+    if (!file.open(filename, html_mapped_file::advice_sequential))
+    {
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+
+    html.assign(file.data(), file.size());
+
+    return true;
+}
+
+// tokenize html repeatedly, return GB/s
+static double benchmark(html_lexer &lexer, const std::string &html)
+{
+    using namespace std::chrono;
+
+    const int iterations = 100;
+
+    lexer.tokenize(html); // warm up
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        lexer.tokenize(html);
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    return html.size() * (double)iterations / seconds / 1e9;
+}
+
+// compare engines side by side
+static void benchmark_engines(int argc, char **argv)
+{
+    using namespace std;
+
+    html_lexer lexer;
+    string html;
+
+    cout << left << setw(32) << "file" << right
+         << setw(16) << "state machine" << setw(16) << "structural"
+         << "  (GB/s)\n";
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!read_file(argv[i], html)) continue;
+
+        lexer.set_engine(html_lexer::engine_state_machine);
+        double state_machine = benchmark(lexer, html);
+
+        lexer.set_engine(html_lexer::engine_structural);
+        double structural = benchmark(lexer, html);
+
+        cout << left << setw(32) << argv[i] << right << fixed
+             << setprecision(3)
+             << setw(16) << state_machine << setw(16) << structural << '\n';
+    }
+}
+
+// tokenize html repeatedly on threads of pool, return GB/s
+static double benchmark_parallel(html_lexer &lexer, const std::string &html,
+                                 html_thread_pool &pool)
+{
+    using namespace std::chrono;
+
+    const int iterations = 100;
+
+    lexer.tokenize_parallel(html, pool); // warm up
+
+    auto start = steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        lexer.tokenize_parallel(html, pool);
+    }
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    return html.size() * (double)iterations / seconds / 1e9;
+}
+
+// hardware counters of tokenize per file
+static void profile_files(int argc, char **argv)
+{
+    const int iterations = 100;
+
+    html_lexer lexer;
+    std::string html;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!read_file(argv[i], html)) continue;
+
+        lexer.tokenize_view(html); // warm up
+
+        profiler prof(argv[i]);
+        for (int j = 0; j < iterations; ++j)
+        {
+            profiler::region region(prof, html.size());
+            lexer.tokenize_view(html);
+        }
+        prof.report();
+    }
+}
+
+// compare parallel mode of 1, 2, 4... threads side by side
+static void benchmark_threads(int argc, char **argv)
+{
+    using namespace std;
+
+    // at least up to 8 threads, to show the cost of seams on small machines
+    size_t cpus = thread::hardware_concurrency();
+    vector<size_t> threads;
+    for (size_t n = 1; n <= 8 || n <= cpus; n *= 2)
+    {
+        threads.push_back(n);
+    }
+
+    vector<unique_ptr<html_thread_pool>> pools;
+    cout << left << setw(32) << "file" << right;
+    for (auto n : threads)
+    {
+        pools.emplace_back(new html_thread_pool(n));
+        cout << setw(10) << n;
+    }
+    cout << "  threads (GB/s), " << cpus << " cpus\n";
+
+    html_lexer lexer;
+    string html;
+
+    for (int i = 2; i < argc; ++i)
+    {
+        if (!read_file(argv[i], html)) continue;
+
+        cout << left << setw(32) << argv[i] << right << fixed
+             << setprecision(3);
+        for (auto &pool : pools)
+        {
+            cout << setw(10) << benchmark_parallel(lexer, html, *pool);
+        }
+        cout << '\n';
+    }
+}
+
+// collect files of paths, a path is a file, a directory searched for *.html
+// and *.htm, or @list of a file per line
+static void collect_files(int argc, char **argv, int first,
+                          std::vector<std::string> &files)
+{
+    namespace fs = std::filesystem;
+
+    for (int i = first; i < argc; ++i)
+    {
+        std::error_code error;
+
+        if (argv[i][0] == '@')
+        {
+            std::ifstream list(argv[i] + 1);
+            std::string line;
+            while (std::getline(list, line))
+            {
+                if (!line.empty()) files.push_back(line);
+            }
+        }
+        else if (fs::is_directory(argv[i], error))
+        {
+            for (fs::recursive_directory_iterator it(argv[i], error), end;
+                 it != end; it.increment(error))
+            {
+                auto extension = it->path().extension();
+                if (it->is_regular_file(error) &&
+                    (extension == ".html" || extension == ".htm"))
+                {
+                    files.push_back(it->path().string());
+                }
+            }
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+}
+
+// batch mode, tokenize files on threads with a lexer per thread. threads
+// and paths are from argv[first], documents are shared by cache if any.
+static void batch(int argc, char **argv, int first,
+                  html_document_cache *cache)
+{
+    using namespace std;
+    using namespace std::chrono;
+
+    vector<string> files;
+    collect_files(argc, argv, first + 1, files);
+
+    html_thread_pool pool(strtoul(argv[first], nullptr, 10));
+
+    // files are mapped instead of read to heap, and lexers are warm lexers
+    // of the thread's html_lexer_pool
+    struct worker
+    {
+        size_t docs   = 0;
+        size_t bytes  = 0;
+        size_t tokens = 0;
+    };
+    vector<worker> workers(pool.size());
+
+    auto start = steady_clock::now();
+
+    pool.parallel_for(files.size(), [&](size_t i, size_t thread)
+    {
+        worker &w = workers[thread];
+        size_t bytes;
+
+        if (cache)
+        {
+            // the cache copies html of a miss
+            html_mapped_file file;
+            if (!file.open(files[i], html_mapped_file::advice_sequential))
+            {
+                return;
+            }
+
+            w.tokens += cache->get(file.view())->get_lexer().size();
+            bytes = file.size();
+        }
+        else
+        {
+            auto lexer = html_lexer_pool::acquire();
+            if (!lexer->tokenize_file(files[i])) return;
+
+            w.tokens += lexer->size();
+            bytes = lexer->get_store().get_html().size();
+        }
+        w.docs  += 1;
+        w.bytes += bytes;
+    });
+
+    double seconds = duration<double>(steady_clock::now() - start).count();
+
+    size_t docs = 0, bytes = 0, tokens = 0;
+    cout << left << setw(8) << "thread" << right << setw(10) << "docs"
+         << setw(14) << "bytes" << setw(12) << "tokens" << '\n';
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        cout << left << setw(8) << i << right << setw(10) << workers[i].docs
+             << setw(14) << workers[i].bytes << setw(12)
+             << workers[i].tokens << '\n';
+        docs   += workers[i].docs;
+        bytes  += workers[i].bytes;
+        tokens += workers[i].tokens;
+    }
+
+    cout << fixed << setprecision(3)
+         << docs << " docs, " << bytes / 1e6 << " MB, " << tokens
+         << " tokens in " << seconds << "s on " << pool.size()
+         << " threads\n"
+         << setprecision(1) << docs / seconds << " docs/s, "
+         << bytes / 1e6 / seconds << " MB/s" << endl;
+
+    if (cache)
+    {
+        auto stats = cache->get_stats();
+        cout << stats.hits << " hits, " << stats.misses << " misses, "
+             << stats.evictions << " evictions, " << stats.documents
+             << " docs of " << setprecision(3) << stats.bytes / 1e6
+             << " MB cached" << endl;
+    }
+}
+
+// format all tokens of a store as print()
+static std::string format_tokens(const html_token_store &store)
+{
+    html_token_writer writer(html_token_writer::no_fd);
+    writer.write(store);
+    return std::string(writer.view());
+}
+
+// check counters of a cache against expected hits, misses and evictions
+static bool check_stats(html_document_cache &cache, const char *name,
+                        size_t hits, size_t misses, size_t evictions)
+{
+    auto stats = cache.get_stats();
+    if (stats.hits == hits && stats.misses == misses &&
+        stats.evictions == evictions)
+    {
+        return true;
+    }
+
+    std::cerr << "Document cache " << name << ": " << stats.hits
+              << " hits, " << stats.misses << " misses, " << stats.evictions
+              << " evictions, expected " << hits << ", " << misses << ", "
+              << evictions << std::endl;
+    return false;
+}
+
+// check documents of cache against a fresh tokenize, then hits, misses and
+// evictions of a single thread on the distinct files of paths from
+// argv[first], and two htmls of the same hash
+static bool check_document_cache(int argc, char **argv, int first,
+                                 html_document_cache &cache)
+{
+    using namespace std;
+
+    vector<string> files;
+    collect_files(argc, argv, first, files);
+    sort(files.begin(), files.end());
+    files.erase(unique(files.begin(), files.end()), files.end());
+
+    // documents cached by threads are tokenized as by a lexer of their own
+    vector<string> htmls;
+    html_lexer lexer;
+    for (auto &file : files)
+    {
+        string html;
+        if (!read_file(file.c_str(), html)) return false;
+
+        lexer.tokenize_view(html);
+        if (format_tokens(cache.get(html)->get_lexer().get_store()) !=
+            format_tokens(lexer.get_store()))
+        {
+            cerr << "Document cache differs: " << file << endl;
+            return false;
+        }
+        htmls.push_back(move(html));
+    }
+
+    // each html is a miss, then a hit
+    html_document_cache counted(size_t(1) << 40);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (auto &html : htmls) counted.get(html);
+    }
+    if (!check_stats(counted, "counts", htmls.size(), htmls.size(), 0))
+    {
+        return false;
+    }
+
+    // least recently used is evicted, with a budget of the two largest of
+    // three documents a, b and c
+    if (htmls.size() >= 3)
+    {
+        vector<pair<size_t, size_t>> sizes; // bytes, index of htmls
+        for (size_t i = 0; i < 3; ++i)
+        {
+            sizes.emplace_back(counted.get(htmls[i])->get_size_in_bytes(), i);
+        }
+        sort(sizes.rbegin(), sizes.rend());
+        const string &a = htmls[sizes[0].second];
+        const string &b = htmls[sizes[1].second];
+        const string &c = htmls[sizes[2].second];
+
+        html_document_cache lru(sizes[0].first + sizes[1].first);
+        lru.get(a);
+        lru.get(b);
+        lru.get(a); // hit, b is least recently used
+        lru.get(c); // evicts b
+        lru.get(a); // hit
+        lru.get(b); // miss, evicts c
+        if (!check_stats(lru, "eviction", 2, 4, 2)) return false;
+    }
+
+    // two htmls of 16 bytes and the same hash. as the hash starts from the
+    // size xor a constant, its state after the first word of a 16 bytes
+    // html is the hash of an 8 bytes html. the second words cancel the
+    // states.
+    uint64_t words[2][2] = {{0x3e766964213c2020ull, 0},
+                            {0x3e7670616e733c20ull, 0}};
+    for (auto &word : words)
+    {
+        uint64_t first_word = word[0] ^ 16 ^ 8;
+        word[1] = html_content_hash(string_view((char *)&first_word, 8));
+    }
+    words[0][1] ^= 0x3e766964 ^ words[1][1];
+    words[1][1]  = 0x3e766964;
+    string first_html((char *)words[0], 16), second_html((char *)words[1], 16);
+
+    html_document_cache collided(size_t(1) << 20);
+    if (html_content_hash(first_html) != html_content_hash(second_html))
+    {
+        cerr << "Document cache collision: no htmls of the same hash" << endl;
+        return false;
+    }
+    auto first_document  = collided.get(first_html);
+    auto second_document = collided.get(second_html);
+    collided.get(first_html);
+    collided.get(second_html);
+    if (first_document->get_html() != first_html ||
+        second_document->get_html() != second_html ||
+        !check_stats(collided, "collision", 2, 2, 0))
+    {
+        cerr << "Document cache collision: documents are mixed up" << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// check lexer pool of the calling thread, a released lexer is leased again
+// and at most max_idle lexers are kept
+static bool check_lexer_pool()
+{
+    using namespace std;
+
+    html_lexer_pool::clear();
+
+    const html_lexer *leased;
+    {
+        auto lexer = html_lexer_pool::acquire();
+        leased = lexer.get();
+
+        // self-move keeps the lexer
+        auto &same = lexer;
+        lexer = std::move(same);
+        if (lexer.get() != leased)
+        {
+            cerr << "Lexer pool: self-move lost the lexer" << endl;
+            return false;
+        }
+    }
+    if (html_lexer_pool::idle_count() != 1 ||
+        html_lexer_pool::acquire().get() != leased)
+    {
+        cerr << "Lexer pool: a released lexer is not leased again" << endl;
+        return false;
+    }
+
+    {
+        vector<html_lexer_pool::lease> leases;
+        for (size_t i = 0; i < html_lexer_pool::max_idle + 2; ++i)
+        {
+            leases.push_back(html_lexer_pool::acquire());
+        }
+    }
+    if (html_lexer_pool::idle_count() != html_lexer_pool::max_idle)
+    {
+        cerr << "Lexer pool: " << html_lexer_pool::idle_count()
+             << " idle lexers, expected " << html_lexer_pool::max_idle
+             << endl;
+        return false;
+    }
+
+    html_lexer_pool::clear();
+    return html_lexer_pool::idle_count() == 0;
+}
+
+// token cache, tokenize and write a cache of each file if none, or map it,
+// then check queries on the cache against the lexer. files are from
+// argv[first], caches are next to them or in directory if any.
+static bool cache_files(int argc, char **argv, int first,
+                        const char *directory)
+{
+    using namespace std;
+    using namespace std::chrono;
+
+    html_lexer lexer;
+    string html;
+
+    cout << left << setw(32) << "file" << setw(10) << "cache" << right
+         << setw(10) << "tokens" << setw(14) << "open (us)"
+         << setw(14) << "tokenize (us)" << '\n';
+
+    for (int i = first; i < argc; ++i)
+    {
+        if (!read_file(argv[i], html)) continue;
+
+        string path = argv[i];
+        if (directory)
+        {
+            path = (filesystem::path(directory) /
+                    filesystem::path(path).filename()).string();
+        }
+        path = html_token_cache::get_path(path);
+        html_token_cache cache;
+
+        auto start = steady_clock::now();
+        bool loaded = cache.open(path, html);
+        double open_us = duration<double, micro>(
+            steady_clock::now() - start).count();
+
+        start = steady_clock::now();
+        lexer.tokenize_view(html);
+        double tokenize_us = duration<double, micro>(
+            steady_clock::now() - start).count();
+
+        if (!loaded && (!html_token_cache::write(path, lexer.get_store()) ||
+                        !cache.open(path, html)))
+        {
+            cerr << "Cannot write " << path << endl;
+            return false;
+        }
+
+        // every tag is found and matched as by the lexer
+        const html_token_store &store = lexer.get_store();
+        bool same = cache.size() == lexer.size();
+        for (size_t pos = 0; same && pos < lexer.size(); ++pos)
+        {
+            same = cache.find_matching_tag(pos) ==
+                   lexer.find_matching_tag(pos);
+
+            auto type = store.get_type(pos);
+            if (type == html_token::token_start_tag ||
+                type == html_token::token_end_tag)
+            {
+                auto name  = store.get_name(store.get_name_id(pos));
+                bool start_tag = type == html_token::token_start_tag;
+                same = same &&
+                       cache.find_tag_by_name(name, start_tag, pos) ==
+                       lexer.find_tag_by_name(name, start_tag, pos);
+            }
+        }
+        if (!same)
+        {
+            cerr << "Token cache differs: " << path << endl;
+            return false;
+        }
+
+        cout << left << setw(32) << argv[i]
+             << setw(10) << (loaded ? "loaded" : "written") << right
+             << setw(10) << cache.size() << fixed << setprecision(1)
+             << setw(14) << (loaded ? open_us : 0.0)
+             << setw(14) << tokenize_us << '\n';
+    }
+
+    return true;
+}
+
+// visitor printing tokens as html_token::print(), names are lower cased
+// here as the token store does
+struct token_printer : html_visitor
+{
+    std::string output;
+
+    void append_lower(std::string_view name)
+    {
+        for (char c : name)
+        {
+            output += (char)tolower((unsigned char)c);
+        }
+    }
+
+    void on_start_tag(const html_tag &tag)
+    {
+        output += "[Start Tag      ] <";
+        append_lower(tag.name);
+        for (size_t i = 0; i < tag.attribute_count; ++i)
+        {
+            output += ' ';
+            append_lower(tag.attributes[i].first);
+            if (!tag.attributes[i].second.empty())
+            {
+                output += "=\"";
+                output += tag.attributes[i].second;
+                output += '"';
+            }
+        }
+        output += tag.self_closing ? "/>\n" : ">\n";
+    }
+    void on_end_tag(const html_tag &tag)
+    {
+        output += "[End Tag        ] </";
+        append_lower(tag.name);
+        output += ">\n";
+    }
+    void on_text(const html_content &content)
+    {
+        output += "[Text           ] ";
+        output += content.content;
+        output += '\n';
+    }
+    void on_comment(const html_content &content)
+    {
+        if (content.type == html_token::token_comment)
+        {
+            output += "[Comment        ] <!--";
+            output += content.content;
+            output += "-->\n";
+        }
+        else
+        {
+            output += "[Bogus Comment  ] ";
+            output += content.content;
+            output += '\n';
+        }
+    }
+    void on_raw_text(const html_content &content)
+    {
+        output += "[Raw Text       ] ";
+        output += content.content;
+        output += '\n';
+    }
+};
+
 int main(int argc, char **argv)
 {
     using namespace std;
 
-    if (argc == 2)
+    if (argc >= 3 && strcmp(argv[1], "-b") == 0)
+    {
+        benchmark_engines(argc, argv);
+    }
+    else if (argc >= 4 && strcmp(argv[1], "-m") == 0)
+    {
+        batch(argc, argv, 2, nullptr);
+    }
+    else if (argc == 3 && strcmp(argv[1], "-u") == 0 &&
+             strcmp(argv[2], "pool") == 0)
+    {
+        if (!check_lexer_pool()) return 1;
+    }
+    else if (argc >= 5 && strcmp(argv[1], "-d") == 0)
+    {
+        // batch mode, repeated documents are tokenized once
+        html_document_cache cache(strtoul(argv[2], nullptr, 10) << 20);
+        batch(argc, argv, 3, &cache);
+    }
+    else if (argc >= 5 && strcmp(argv[1], "-u") == 0 &&
+             strcmp(argv[2], "cache") == 0)
+    {
+        // check a document cache filled by batch mode on threads
+        html_document_cache cache(size_t(64) << 20);
+        batch(argc, argv, 3, &cache);
+        if (!check_document_cache(argc, argv, 4, cache)) return 1;
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-k") == 0)
+    {
+        // -k -o directory keeps caches out of the directories of files
+        bool output = argc >= 5 && strcmp(argv[2], "-o") == 0;
+        if (!cache_files(argc, argv, output ? 4 : 2,
+                         output ? argv[3] : nullptr))
+        {
+            return 1;
+        }
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-c") == 0)
     {
-        std::ifstream file(argv[1]);
-        if (file.is_open())
+        profile_files(argc, argv);
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-s") == 0)
+    {
+        benchmark_threads(argc, argv);
+    }
+    else if (argc == 4 && strcmp(argv[1], "-t") == 0)
+    {
+        // parallel mode, split even small files to exercise the seams
+        size_t threads = strtoul(argv[2], nullptr, 10);
+        std::string html;
+        if (threads == 0 || !read_file(argv[3], html))
         {
-            // read file content
-            std::string html((std::istreambuf_iterator<char>(file)),
-                             (std::istreambuf_iterator<char>()    ));
-            file.close();
+            cerr << "Cannot tokenize " << argv[3] << " on "
+                 << argv[2] << " threads\n";
+            return 1;
+        }
 
-            stopwatch<double> timer("Tokenize HTML");
+        html_thread_pool pool(threads);
+        html_lexer lexer;
+        lexer.tokenize_parallel(html, pool, 1);
+        lexer.print();
+    }
+    else if (argc == 4 && strcmp(argv[1], "-p") == 0)
+    {
+        // push mode, read file in chunks as if they arrive from network
+        size_t chunk_size = strtoul(argv[2], nullptr, 10);
+        ifstream file(argv[3], ios::in | ios::binary);
+        if (chunk_size == 0 || !file)
+        {
+            cerr << "Cannot read " << argv[3] << " in chunks of "
+                 << argv[2] << " bytes\n";
+            return 1;
+        }
 
-            timer.start();
+        // tokens are valid during the call only, the writer copies them
+        html_token_writer writer;
+        html_lexer lexer;
+        lexer.set_token_handler([&writer](const html_token &token)
+        {
+            writer.write(token);
+        });
 
-            // tokenize
-            html_lexer lexer(html);
+        std::string chunk(chunk_size, '\0');
+        while (file.read(&chunk[0], chunk_size) || file.gcount() > 0)
+        {
+            lexer.feed(chunk.data(), file.gcount());
+        }
+        lexer.finish();
+        writer.flush();
+    }
+    else if (argc == 3 && strcmp(argv[1], "-v") == 0)
+    {
+        // visitor, tokens are printed without building the token table
+        std::string html;
+        if (!read_file(argv[2], html)) return 1;
 
-            timer.stop();
+        html_lexer lexer;
+        token_printer printer;
+        lexer.tokenize(html, printer);
+        cout << printer.output;
+        cout.flush();
+    }
+    else if ((argc == 3 || argc == 4) && strcmp(argv[1], "-l") == 0)
+    {
+        // lazy mode, pull tokens by the iterator, or the first count tokens
+        // only and check nothing after them was tokenized
+        std::string html;
+        if (!read_file(argv[argc - 1], html)) return 1;
 
-            // print tokens
-            lexer.print();
+        size_t count = argc == 4 ? strtoul(argv[2], nullptr, 10) : -1;
+        html_token_writer writer;
+        html_lexer lexer;
+        lexer.tokenize_lazy(html);
+
+        size_t pulled = 0;
+        for (html_token token : lexer)
+        {
+            writer.write(token);
+            if (++pulled == count) break;
+        }
+        writer.flush();
+
+        if (lexer.size() != pulled)
+        {
+            cerr << "Lazy mode tokenized " << lexer.size() << " tokens, "
+                 << pulled << " pulled: " << argv[argc - 1] << endl;
+            return 1;
+        }
+    }
+    else if (argc == 4 && strcmp(argv[1], "-q") == 0)
+    {
+        // css selector, print start tag of each element found
+        html_selector selector(argv[2]);
+        html_lexer lexer;
+        if (!selector.is_valid())
+        {
+            cerr << "Invalid selector: " << argv[2] << endl;
+            return 1;
+        }
+        if (!lexer.tokenize_file(argv[3]))
+        {
+            cerr << "Failed to open file: " << argv[3] << endl;
+            return 1;
+        }
+
+        std::string_view html = lexer.get_store().get_html();
+        for (auto &range : lexer.select(selector))
+        {
+            html_token token = lexer.get_token(range.first);
+            size_t start = token.get_start_position();
+            cout << '[' << range.first << ", " << range.last << ") "
+                 << html.substr(start, token.get_end_position() - start)
+                 << '\n';
+        }
+    }
+    else if (argc == 3 && strcmp(argv[1], "-j") == 0)
+    {
+        // json lines for other tools
+        html_lexer lexer;
+        if (!lexer.tokenize_file(argv[2]))
+        {
+            cerr << "Failed to open file: " << argv[2] << endl;
+            return 1;
+        }
+
+        html_token_writer writer(html_token_writer::stdout_fd,
+                                 html_token_writer::format_json_lines);
+        writer.write(lexer.get_store());
+        writer.flush();
+    }
+    else if (argc == 2 || (argc == 4 && strcmp(argv[1], "-e") == 0))
+    {
+        html_lexer lexer;
+
+        if (argc == 4 && strcmp(argv[2], "structural") == 0)
+        {
+            lexer.set_engine(html_lexer::engine_structural);
+        }
+
+        stopwatch<double> timer("Tokenize HTML");
+
+        timer.start();
+
+        // map and tokenize, the file is not copied to heap
+        bool tokenized = lexer.tokenize_file(argv[argc - 1]);
+
+        timer.stop();
+
+        if (!tokenized)
+        {
+            cerr << "Failed to open file: " << argv[argc - 1] << endl;
         }
         else
         {
-            cerr << "Failed to open file: " << argv[1] << endl;
+            cerr << "[Token Store     ] " << lexer.get_allocation_count()
+                 << " allocations, " << lexer.get_allocated_bytes()
+                 << " bytes\n";
+
+            // built with make STATS=1
+            if (html_lexer::stats_enabled)
+            {
+                lexer.print_stats();
+            }
+
+            // print tokens
+            lexer.print();
         }
     }
     else
     {
-        cerr << "Usage: " << argv[0] << " filename.html" << endl;
+        cerr << "Usage: " << argv[0] << " filename.html\n"
+             << "       " << argv[0] << " -e state_machine|structural"
+             << " filename.html\n"
+             << "       " << argv[0] << " -p chunk_size filename.html"
+             << "  push mode\n"
+             << "       " << argv[0] << " -t threads filename.html"
+             << "  parallel mode\n"
+             << "       " << argv[0] << " -v filename.html"
+             << "  visitor\n"
+             << "       " << argv[0] << " -l [count] filename.html"
+             << "  lazy mode, the first count tokens\n"
+             << "       " << argv[0] << " -j filename.html"
+             << "  json lines\n"
+             << "       " << argv[0] << " -q selector filename.html"
+             << "  css selector\n"
+             << "       " << argv[0] << " -b filename.html..."
+             << "  compare engines in GB/s\n"
+             << "       " << argv[0] << " -c filename.html..."
+             << "  hardware counters of tokenize\n"
+             << "       " << argv[0] << " -s filename.html..."
+             << "  compare threads of parallel mode in GB/s\n"
+             << "       " << argv[0] << " -m threads file|directory|@list..."
+             << "  batch mode, 0 threads for a thread per cpu\n"
+             << "       " << argv[0]
+             << " -d budget_mb threads file|directory|@list..."
+             << "  batch mode with document cache\n"
+             << "       " << argv[0]
+             << " -u cache threads file|directory|@list..."
+             << "  check document cache\n"
+             << "       " << argv[0] << " -u pool"
+             << "  check lexer pool\n"
+             << "       " << argv[0] << " -k [-o directory] filename.html..."
+             << "  write or load token caches filename.html.tok" << endl;
     }
 
     return 0;
@@ -0,0 +1,162 @@
+//
+// HTML Lexer - Arena
+// A monotonic allocator for the interned names of a token store
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_ARENA__
+#define __HTML_ARENA__
+
+#include <cstddef> // size_t, max_align_t
+#include <cstdint> // uintptr_t
+#include <cstdlib> // malloc(), free()
+#include <new>     // bad_alloc
+
+//
+// html_arena - bump allocator over a chain of chunks.
+//
+// - html_token_store allocates lower case copies of tag and attribute
+//   names here, tokens are rows of its tables and not in the arena.
+// - Memory is never freed one by one, reset() rewinds to the first chunk in
+//   O(1) and keeps all chunks for the next document.
+//
+class html_arena
+{
+private:
+    struct chunk
+    {
+        chunk  *next;
+        size_t  size; // usable bytes after the header
+    };
+
+    // the first chunk size, each new chunk doubles the total capacity
+    static const size_t min_chunk_size = 64 * 1024;
+
+    // chain of chunks, and the chunk in use
+    chunk *_first;
+    chunk *_current;
+
+    // free space [_ptr, _end) of current chunk
+    char *_ptr;
+    char *_end;
+
+    // statistics, heap allocations and bytes owned
+    size_t _allocations;
+    size_t _capacity;
+
+    static char *chunk_begin(chunk *c) {return (char *)(c + 1);}
+
+    static char *align_up(char *p, size_t align)
+    {
+        return (char *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    // allocate from current chunk, return nullptr if it does not fit
+    void *try_allocate(size_t size, size_t align)
+    {
+        if (_ptr == nullptr) return nullptr;
+
+        char *p = align_up(_ptr, align);
+        if (p > _end || (size_t)(_end - p) < size) return nullptr;
+
+        _ptr = p + size;
+        return p;
+    }
+
+    // move to next chunk, or add a new chunk
+    void *grow(size_t size, size_t align)
+    {
+        // reuse chunks kept by reset()
+        while (_current != nullptr && _current->next != nullptr)
+        {
+            use(_current->next);
+
+            void *p = try_allocate(size, align);
+            if (p != nullptr) return p;
+        }
+
+        size_t chunk_size = _capacity < min_chunk_size ?
+                            min_chunk_size : _capacity;
+        if (chunk_size < size + align)
+        {
+            chunk_size = size + align;
+        }
+
+        chunk *c = (chunk *)std::malloc(sizeof(chunk) + chunk_size);
+        if (c == nullptr) throw std::bad_alloc();
+
+        c->next = nullptr;
+        c->size = chunk_size;
+        ++_allocations;
+        _capacity += chunk_size;
+
+        if (_current == nullptr)
+        {
+            _first = c;
+        }
+        else
+        {
+            _current->next = c;
+        }
+        use(c);
+
+        return try_allocate(size, align);
+    }
+
+    void use(chunk *c)
+    {
+        _current = c;
+        _ptr     = chunk_begin(c);
+        _end     = _ptr + c->size;
+    }
+
+public:
+    html_arena() :
+        _first(nullptr), _current(nullptr), _ptr(nullptr), _end(nullptr),
+        _allocations(0), _capacity(0) {}
+
+    ~html_arena()
+    {
+        chunk *c = _first;
+        while (c != nullptr)
+        {
+            chunk *next = c->next;
+            std::free(c);
+            c = next;
+        }
+    }
+
+    html_arena(const html_arena &) = delete;
+    html_arena &operator=(const html_arena &) = delete;
+
+    // allocate raw memory
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        void *p = try_allocate(size, align);
+        return p != nullptr ? p : grow(size, align);
+    }
+
+    // allocate an uninitialized array
+    template <typename T>
+    T *allocate_array(size_t n)
+    {
+        return (T *)allocate(n * sizeof(T), alignof(T));
+    }
+
+    // release all allocations in O(1), chunks are kept for reuse
+    void reset()
+    {
+        if (_first != nullptr)
+        {
+            use(_first);
+        }
+    }
+
+    // get the number of chunks allocated from heap
+    size_t get_allocation_count() const {return _allocations;}
+
+    // get the bytes owned by arena
+    size_t get_capacity() const {return _capacity;}
+};
+
+#endif // __HTML_ARENA__
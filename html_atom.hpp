@@ -0,0 +1,468 @@
+//
+// HTML Lexer - Atoms
+// Known tag and attribute names with ids fixed at compile time
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_ATOM__
+#define __HTML_ATOM__
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t
+#include <string_view>
+
+// known names, X(id, name). names are lower case, tags first.
+#define HTML_ATOMS(X) \
+    X(doctype, "!doctype")                  \
+    X(a, "a")                               \
+    X(abbr, "abbr")                         \
+    X(acronym, "acronym")                   \
+    X(address, "address")                   \
+    X(applet, "applet")                     \
+    X(area, "area")                         \
+    X(article, "article")                   \
+    X(aside, "aside")                       \
+    X(audio, "audio")                       \
+    X(b, "b")                               \
+    X(base, "base")                         \
+    X(basefont, "basefont")                 \
+    X(bdi, "bdi")                           \
+    X(bdo, "bdo")                           \
+    X(big, "big")                           \
+    X(blockquote, "blockquote")             \
+    X(body, "body")                         \
+    X(br, "br")                             \
+    X(button, "button")                     \
+    X(canvas, "canvas")                     \
+    X(caption, "caption")                   \
+    X(center, "center")                     \
+    X(cite, "cite")                         \
+    X(code, "code")                         \
+    X(col, "col")                           \
+    X(colgroup, "colgroup")                 \
+    X(data, "data")                         \
+    X(datalist, "datalist")                 \
+    X(dd, "dd")                             \
+    X(del, "del")                           \
+    X(details, "details")                   \
+    X(dfn, "dfn")                           \
+    X(dialog, "dialog")                     \
+    X(dir, "dir")                           \
+    X(div, "div")                           \
+    X(dl, "dl")                             \
+    X(dt, "dt")                             \
+    X(em, "em")                             \
+    X(embed, "embed")                       \
+    X(fieldset, "fieldset")                 \
+    X(figcaption, "figcaption")             \
+    X(figure, "figure")                     \
+    X(font, "font")                         \
+    X(footer, "footer")                     \
+    X(form, "form")                         \
+    X(frame, "frame")                       \
+    X(frameset, "frameset")                 \
+    X(h1, "h1")                             \
+    X(h2, "h2")                             \
+    X(h3, "h3")                             \
+    X(h4, "h4")                             \
+    X(h5, "h5")                             \
+    X(h6, "h6")                             \
+    X(head, "head")                         \
+    X(header, "header")                     \
+    X(hgroup, "hgroup")                     \
+    X(hr, "hr")                             \
+    X(html, "html")                         \
+    X(i, "i")                               \
+    X(iframe, "iframe")                     \
+    X(img, "img")                           \
+    X(input, "input")                       \
+    X(ins, "ins")                           \
+    X(kbd, "kbd")                           \
+    X(label, "label")                       \
+    X(legend, "legend")                     \
+    X(li, "li")                             \
+    X(link, "link")                         \
+    X(main, "main")                         \
+    X(map, "map")                           \
+    X(mark, "mark")                         \
+    X(marquee, "marquee")                   \
+    X(math, "math")                         \
+    X(menu, "menu")                         \
+    X(meta, "meta")                         \
+    X(meter, "meter")                       \
+    X(nav, "nav")                           \
+    X(nobr, "nobr")                         \
+    X(noframes, "noframes")                 \
+    X(noscript, "noscript")                 \
+    X(object, "object")                     \
+    X(ol, "ol")                             \
+    X(optgroup, "optgroup")                 \
+    X(option, "option")                     \
+    X(output, "output")                     \
+    X(p, "p")                               \
+    X(param, "param")                       \
+    X(path, "path")                         \
+    X(picture, "picture")                   \
+    X(pre, "pre")                           \
+    X(progress, "progress")                 \
+    X(q, "q")                               \
+    X(rp, "rp")                             \
+    X(rt, "rt")                             \
+    X(ruby, "ruby")                         \
+    X(s, "s")                               \
+    X(samp, "samp")                         \
+    X(script, "script")                     \
+    X(search, "search")                     \
+    X(section, "section")                   \
+    X(select, "select")                     \
+    X(slot, "slot")                         \
+    X(small, "small")                       \
+    X(source, "source")                     \
+    X(span, "span")                         \
+    X(strike, "strike")                     \
+    X(strong, "strong")                     \
+    X(style, "style")                       \
+    X(sub, "sub")                           \
+    X(summary, "summary")                   \
+    X(sup, "sup")                           \
+    X(svg, "svg")                           \
+    X(table, "table")                       \
+    X(tbody, "tbody")                       \
+    X(td, "td")                             \
+    X(template, "template")                 \
+    X(textarea, "textarea")                 \
+    X(tfoot, "tfoot")                       \
+    X(th, "th")                             \
+    X(thead, "thead")                       \
+    X(time, "time")                         \
+    X(title, "title")                       \
+    X(tr, "tr")                             \
+    X(track, "track")                       \
+    X(tt, "tt")                             \
+    X(u, "u")                               \
+    X(ul, "ul")                             \
+    X(var, "var")                           \
+    X(video, "video")                       \
+    X(wbr, "wbr")                           \
+    /* attributes */ \
+    X(accept, "accept")                     \
+    X(accept_charset, "accept-charset")     \
+    X(accesskey, "accesskey")               \
+    X(action, "action")                     \
+    X(align, "align")                       \
+    X(allow, "allow")                       \
+    X(allowfullscreen, "allowfullscreen")   \
+    X(alt, "alt")                           \
+    X(aria_describedby, "aria-describedby") \
+    X(aria_expanded, "aria-expanded")       \
+    X(aria_haspopup, "aria-haspopup")       \
+    X(aria_hidden, "aria-hidden")           \
+    X(aria_label, "aria-label")             \
+    X(aria_labelledby, "aria-labelledby")   \
+    X(async, "async")                       \
+    X(autocapitalize, "autocapitalize")     \
+    X(autocomplete, "autocomplete")         \
+    X(autocorrect, "autocorrect")           \
+    X(autofocus, "autofocus")               \
+    X(autoplay, "autoplay")                 \
+    X(bgcolor, "bgcolor")                   \
+    X(border, "border")                     \
+    X(cellpadding, "cellpadding")           \
+    X(cellspacing, "cellspacing")           \
+    X(charset, "charset")                   \
+    X(checked, "checked")                   \
+    X(class, "class")                       \
+    X(color, "color")                       \
+    X(cols, "cols")                         \
+    X(colspan, "colspan")                   \
+    X(content, "content")                   \
+    X(contenteditable, "contenteditable")   \
+    X(controls, "controls")                 \
+    X(coords, "coords")                     \
+    X(crossorigin, "crossorigin")           \
+    X(d, "d")                               \
+    X(datetime, "datetime")                 \
+    X(decoding, "decoding")                 \
+    X(default, "default")                   \
+    X(defer, "defer")                       \
+    X(dirname, "dirname")                   \
+    X(disabled, "disabled")                 \
+    X(download, "download")                 \
+    X(draggable, "draggable")               \
+    X(enctype, "enctype")                   \
+    X(enterkeyhint, "enterkeyhint")         \
+    X(fill, "fill")                         \
+    X(for, "for")                           \
+    X(formaction, "formaction")             \
+    X(frameborder, "frameborder")           \
+    X(headers, "headers")                   \
+    X(height, "height")                     \
+    X(hidden, "hidden")                     \
+    X(high, "high")                         \
+    X(href, "href")                         \
+    X(hreflang, "hreflang")                 \
+    X(http_equiv, "http-equiv")             \
+    X(id, "id")                             \
+    X(inert, "inert")                       \
+    X(inputmode, "inputmode")               \
+    X(integrity, "integrity")               \
+    X(is, "is")                             \
+    X(ismap, "ismap")                       \
+    X(itemid, "itemid")                     \
+    X(itemprop, "itemprop")                 \
+    X(itemref, "itemref")                   \
+    X(itemscope, "itemscope")               \
+    X(itemtype, "itemtype")                 \
+    X(kind, "kind")                         \
+    X(lang, "lang")                         \
+    X(language, "language")                 \
+    X(list, "list")                         \
+    X(loading, "loading")                   \
+    X(loop, "loop")                         \
+    X(low, "low")                           \
+    X(manifest, "manifest")                 \
+    X(max, "max")                           \
+    X(maxlength, "maxlength")               \
+    X(media, "media")                       \
+    X(method, "method")                     \
+    X(min, "min")                           \
+    X(minlength, "minlength")               \
+    X(multiple, "multiple")                 \
+    X(muted, "muted")                       \
+    X(name, "name")                         \
+    X(nomodule, "nomodule")                 \
+    X(nonce, "nonce")                       \
+    X(novalidate, "novalidate")             \
+    X(onblur, "onblur")                     \
+    X(onchange, "onchange")                 \
+    X(onclick, "onclick")                   \
+    X(onerror, "onerror")                   \
+    X(onfocus, "onfocus")                   \
+    X(oninput, "oninput")                   \
+    X(onkeydown, "onkeydown")               \
+    X(onkeypress, "onkeypress")             \
+    X(onkeyup, "onkeyup")                   \
+    X(onload, "onload")                     \
+    X(onmousedown, "onmousedown")           \
+    X(onmouseout, "onmouseout")             \
+    X(onmouseover, "onmouseover")           \
+    X(onmouseup, "onmouseup")               \
+    X(onreset, "onreset")                   \
+    X(onresize, "onresize")                 \
+    X(onscroll, "onscroll")                 \
+    X(onselect, "onselect")                 \
+    X(onsubmit, "onsubmit")                 \
+    X(onunload, "onunload")                 \
+    X(open, "open")                         \
+    X(optimum, "optimum")                   \
+    X(pattern, "pattern")                   \
+    X(ping, "ping")                         \
+    X(placeholder, "placeholder")           \
+    X(playsinline, "playsinline")           \
+    X(poster, "poster")                     \
+    X(preload, "preload")                   \
+    X(property, "property")                 \
+    X(readonly, "readonly")                 \
+    X(referrerpolicy, "referrerpolicy")     \
+    X(rel, "rel")                           \
+    X(required, "required")                 \
+    X(rev, "rev")                           \
+    X(reversed, "reversed")                 \
+    X(role, "role")                         \
+    X(rows, "rows")                         \
+    X(rowspan, "rowspan")                   \
+    X(sandbox, "sandbox")                   \
+    X(scope, "scope")                       \
+    X(scrolling, "scrolling")               \
+    X(selected, "selected")                 \
+    X(shape, "shape")                       \
+    X(size, "size")                         \
+    X(sizes, "sizes")                       \
+    X(spellcheck, "spellcheck")             \
+    X(src, "src")                           \
+    X(srcdoc, "srcdoc")                     \
+    X(srclang, "srclang")                   \
+    X(srcset, "srcset")                     \
+    X(start, "start")                       \
+    X(step, "step")                         \
+    X(stroke, "stroke")                     \
+    X(tabindex, "tabindex")                 \
+    X(target, "target")                     \
+    X(translate, "translate")               \
+    X(type, "type")                         \
+    X(usemap, "usemap")                     \
+    X(valign, "valign")                     \
+    X(value, "value")                       \
+    X(version, "version")                   \
+    X(viewbox, "viewbox")                   \
+    X(width, "width")                       \
+    X(wrap, "wrap")                         \
+    X(xmlns, "xmlns")                       \
+    X(xmlns_xlink, "xmlns:xlink")           \
+    X(xlink_href, "xlink:href")             \
+
+// atom ids of known names, e.g. atom_div, atom_class
+enum html_atom : uint32_t
+{
+#define HTML_ATOM_ENUM(id, name) atom_##id,
+    HTML_ATOMS(HTML_ATOM_ENUM)
+#undef HTML_ATOM_ENUM
+    atom_count
+};
+
+//
+// html_atom_hash - perfect hash of known names, built at compile time.
+//
+// Hash and displace: names are hashed into buckets, each bucket gets a
+// displacement which moves all its names to free slots. A lookup hashes the
+// name once, and compares it with the only candidate.
+//
+struct html_atom_hash
+{
+    static constexpr std::string_view names[] =
+    {
+#define HTML_ATOM_NAME(id, name) name,
+        HTML_ATOMS(HTML_ATOM_NAME)
+#undef HTML_ATOM_NAME
+    };
+
+    // table size, buckets and slots are powers of 2
+    static const size_t bucket_count = 128;
+    static const size_t slot_count   = 1024;
+    static const size_t slot_shift   = 22; // 32 - log2(slot_count)
+
+    struct hash_table
+    {
+        uint32_t displacements[bucket_count];
+        uint16_t slots[slot_count]; // atom id, or 0xffff if empty
+        bool     complete;          // all names are placed
+    };
+
+    // case insensitive FNV-1a, letters are folded by setting bit 5, which
+    // keeps digits, '-', ':' and '!' of known names
+    static constexpr uint32_t hash(std::string_view name)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            h ^= (uint8_t)(name[i] | 0x20);
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    // slot of a hash displaced by d
+    static constexpr size_t slot(uint32_t h, uint32_t d)
+    {
+        return (uint32_t)((h ^ d) * 2654435761u) >> slot_shift;
+    }
+
+    // place the largest buckets first, try displacements until all names
+    // of a bucket land in free slots
+    static constexpr hash_table build()
+    {
+        hash_table table = {};
+        for (size_t i = 0; i < slot_count; ++i)
+        {
+            table.slots[i] = 0xffff;
+        }
+
+        uint32_t sizes[bucket_count] = {};
+        for (size_t i = 0; i < atom_count; ++i)
+        {
+            ++sizes[hash(names[i]) % bucket_count];
+        }
+
+        table.complete = true;
+        for (uint32_t size = atom_count; size > 0; --size)
+        {
+            for (size_t b = 0; b < bucket_count; ++b)
+            {
+                if (sizes[b] != size) continue;
+
+                bool placed = false;
+                for (uint32_t d = 0; d < 1u << 16 && !placed; ++d)
+                {
+                    // slots taken by this bucket with displacement d
+                    size_t taken[atom_count] = {};
+                    size_t count = 0;
+
+                    placed = true;
+                    for (size_t i = 0; i < atom_count && placed; ++i)
+                    {
+                        uint32_t h = hash(names[i]);
+                        if (h % bucket_count != b) continue;
+
+                        size_t s = slot(h, d);
+                        if (table.slots[s] != 0xffff) placed = false;
+                        for (size_t j = 0; j < count && placed; ++j)
+                        {
+                            if (taken[j] == s) placed = false;
+                        }
+                        taken[count++] = s;
+                    }
+
+                    if (placed)
+                    {
+                        table.displacements[b] = d;
+                        for (size_t i = 0; i < atom_count; ++i)
+                        {
+                            uint32_t h = hash(names[i]);
+                            if (h % bucket_count == b)
+                            {
+                                table.slots[slot(h, d)] = (uint16_t)i;
+                            }
+                        }
+                    }
+                }
+
+                if (!placed) table.complete = false;
+            }
+        }
+
+        return table;
+    }
+};
+
+// html_atoms - known names and their atom ids
+class html_atoms
+{
+private:
+    typedef html_atom_hash hash;
+
+    static constexpr html_atom_hash::hash_table _table = hash::build();
+    static_assert(_table.complete, "html_atoms: no perfect hash found");
+
+public:
+    // not a known name
+    static const uint32_t none = -1;
+
+    // get atom of name, case insensitive, return none if name is not known
+    static uint32_t find(std::string_view name)
+    {
+        uint32_t h = hash::hash(name);
+        uint32_t atom = _table.slots[
+            hash::slot(h, _table.displacements[h % hash::bucket_count])];
+        if (atom == 0xffff) return none;
+
+        // compare with the candidate
+        std::string_view known = hash::names[atom];
+        if (known.size() != name.size()) return none;
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            char c = name[i];
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            if (c != known[i]) return none;
+        }
+
+        return atom;
+    }
+
+    // get lower case name of an atom
+    static std::string_view get_name(uint32_t atom)
+    {
+        return hash::names[atom];
+    }
+};
+
+#endif // __HTML_ATOM__
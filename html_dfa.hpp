@@ -0,0 +1,259 @@
+//
+// HTML Lexer - DFA
+// Character class and transition tables of the table-driven state machine
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_DFA__
+#define __HTML_DFA__
+
+//
+// html_dfa - tables of html_lexer::run_dfa(), built at compile time.
+//
+// A byte is mapped to a character class, then state x class gives the next
+// state and an action. Runs of text, names and values are still skipped by
+// the actions, and raw text, markup declarations and bogus comments are
+// still searched by process_...() functions.
+//
+struct html_dfa
+{
+    typedef html_lexer::state_type state_type;
+
+    // character classes, letters are ASCII as isupper()/islower() of the
+    // "C" locale
+    enum class_type
+    {
+        class_other,
+        class_space,    // ' ', '\n', '\r', '\t'
+        class_letter,   // A-Z, a-z
+        class_lt,       // '<'
+        class_gt,       // '>'
+        class_slash,    // '/'
+        class_bang,     // '!'
+        class_question, // '?'
+        class_equal,    // '='
+        class_dquote,   // '"'
+        class_squote,   // '\''
+        class_count
+    };
+
+    // what to do after moving to the next state
+    enum action_type
+    {
+        action_none,
+        action_reconsume,           // do not consume the character
+        action_tag_open,            // '<' in data state
+        action_append_text,
+        action_new_start_tag,
+        action_new_end_tag,
+        action_append_tag_name,
+        action_new_attribute,
+        action_append_attribute_name,
+        action_start_value,
+        action_append_value,        // unquoted
+        action_append_value_dquote,
+        action_append_value_squote,
+        action_emit,
+        action_emit_self_closing,
+        action_bogus_comment,
+        action_markup_declaration,
+        action_raw_text
+    };
+
+    struct transition
+    {
+        unsigned char next;   // state_type
+        unsigned char action; // action_type
+    };
+
+    struct tables
+    {
+        unsigned char classes[256];
+        transition    transitions[html_lexer::state_count][class_count];
+    };
+
+    static constexpr tables build()
+    {
+        tables t = {};
+
+        for (int c = 0; c < 256; ++c)
+        {
+            t.classes[c] = class_other;
+        }
+        t.classes[(unsigned char)' ']  = class_space;
+        t.classes[(unsigned char)'\n'] = class_space;
+        t.classes[(unsigned char)'\r'] = class_space;
+        t.classes[(unsigned char)'\t'] = class_space;
+        for (int c = 'A'; c <= 'Z'; ++c)
+        {
+            t.classes[c] = class_letter;
+            t.classes[c - 'A' + 'a'] = class_letter;
+        }
+        t.classes[(unsigned char)'<']  = class_lt;
+        t.classes[(unsigned char)'>']  = class_gt;
+        t.classes[(unsigned char)'/']  = class_slash;
+        t.classes[(unsigned char)'!']  = class_bang;
+        t.classes[(unsigned char)'?']  = class_question;
+        t.classes[(unsigned char)'=']  = class_equal;
+        t.classes[(unsigned char)'"']  = class_dquote;
+        t.classes[(unsigned char)'\''] = class_squote;
+
+        // a state goes to next with action on all classes, then the
+        // classes it treats differently are set
+        auto all = [&t](state_type state, state_type next, action_type action)
+        {
+            for (int c = 0; c < class_count; ++c)
+            {
+                t.transitions[state][c] = {(unsigned char)next,
+                                           (unsigned char)action};
+            }
+        };
+        auto on = [&t](state_type state, class_type c, state_type next,
+                       action_type action)
+        {
+            t.transitions[state][c] = {(unsigned char)next,
+                                       (unsigned char)action};
+        };
+
+        all(html_lexer::state_data, html_lexer::state_data,
+            action_append_text);
+        on(html_lexer::state_data, class_lt, html_lexer::state_tag_open,
+           action_tag_open);
+
+        all(html_lexer::state_tag_open, html_lexer::state_data,
+            action_reconsume);
+        on(html_lexer::state_tag_open, class_bang,
+           html_lexer::state_markup_declaration_open, action_none);
+        on(html_lexer::state_tag_open, class_slash,
+           html_lexer::state_end_tag_open, action_none);
+        on(html_lexer::state_tag_open, class_letter,
+           html_lexer::state_tag_name, action_new_start_tag);
+        on(html_lexer::state_tag_open, class_question,
+           html_lexer::state_bogus_comment, action_none);
+
+        all(html_lexer::state_end_tag_open, html_lexer::state_bogus_comment,
+            action_none);
+        on(html_lexer::state_end_tag_open, class_letter,
+           html_lexer::state_tag_name, action_new_end_tag);
+        on(html_lexer::state_end_tag_open, class_gt,
+           html_lexer::state_data, action_none);
+
+        all(html_lexer::state_tag_name, html_lexer::state_tag_name,
+            action_append_tag_name);
+        on(html_lexer::state_tag_name, class_space,
+           html_lexer::state_before_attribute_name, action_none);
+        on(html_lexer::state_tag_name, class_slash,
+           html_lexer::state_self_closing_start_tag, action_none);
+        on(html_lexer::state_tag_name, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_before_attribute_name,
+            html_lexer::state_attribute_name, action_new_attribute);
+        on(html_lexer::state_before_attribute_name, class_space,
+           html_lexer::state_before_attribute_name, action_none);
+        on(html_lexer::state_before_attribute_name, class_slash,
+           html_lexer::state_self_closing_start_tag, action_none);
+        on(html_lexer::state_before_attribute_name, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_attribute_name,
+            html_lexer::state_attribute_name, action_append_attribute_name);
+        on(html_lexer::state_attribute_name, class_space,
+           html_lexer::state_after_attribute_name, action_none);
+        on(html_lexer::state_attribute_name, class_slash,
+           html_lexer::state_self_closing_start_tag, action_none);
+        on(html_lexer::state_attribute_name, class_equal,
+           html_lexer::state_before_attribute_value, action_none);
+        on(html_lexer::state_attribute_name, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_after_attribute_name,
+            html_lexer::state_attribute_name, action_new_attribute);
+        on(html_lexer::state_after_attribute_name, class_space,
+           html_lexer::state_after_attribute_name, action_none);
+        on(html_lexer::state_after_attribute_name, class_slash,
+           html_lexer::state_self_closing_start_tag, action_none);
+        on(html_lexer::state_after_attribute_name, class_equal,
+           html_lexer::state_before_attribute_value, action_none);
+        on(html_lexer::state_after_attribute_name, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_before_attribute_value,
+            html_lexer::state_attribute_value_unquoted, action_start_value);
+        on(html_lexer::state_before_attribute_value, class_space,
+           html_lexer::state_before_attribute_value, action_none);
+        on(html_lexer::state_before_attribute_value, class_dquote,
+           html_lexer::state_attribute_value_double_quoted, action_none);
+        on(html_lexer::state_before_attribute_value, class_squote,
+           html_lexer::state_attribute_value_single_quoted, action_none);
+        on(html_lexer::state_before_attribute_value, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_attribute_value_double_quoted,
+            html_lexer::state_attribute_value_double_quoted,
+            action_append_value_dquote);
+        on(html_lexer::state_attribute_value_double_quoted, class_dquote,
+           html_lexer::state_after_attribute_value_quoted, action_none);
+
+        all(html_lexer::state_attribute_value_single_quoted,
+            html_lexer::state_attribute_value_single_quoted,
+            action_append_value_squote);
+        on(html_lexer::state_attribute_value_single_quoted, class_squote,
+           html_lexer::state_after_attribute_value_quoted, action_none);
+
+        all(html_lexer::state_attribute_value_unquoted,
+            html_lexer::state_attribute_value_unquoted, action_append_value);
+        on(html_lexer::state_attribute_value_unquoted, class_space,
+           html_lexer::state_before_attribute_name, action_none);
+        on(html_lexer::state_attribute_value_unquoted, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_after_attribute_value_quoted,
+            html_lexer::state_before_attribute_name, action_reconsume);
+        on(html_lexer::state_after_attribute_value_quoted, class_space,
+           html_lexer::state_before_attribute_name, action_none);
+        on(html_lexer::state_after_attribute_value_quoted, class_slash,
+           html_lexer::state_self_closing_start_tag, action_none);
+        on(html_lexer::state_after_attribute_value_quoted, class_gt,
+           html_lexer::state_data, action_emit);
+
+        all(html_lexer::state_self_closing_start_tag,
+            html_lexer::state_before_attribute_name, action_reconsume);
+        on(html_lexer::state_self_closing_start_tag, class_gt,
+           html_lexer::state_data, action_emit_self_closing);
+
+        // process_...() functions set the state when done
+        all(html_lexer::state_bogus_comment, html_lexer::state_bogus_comment,
+            action_bogus_comment);
+        all(html_lexer::state_markup_declaration_open,
+            html_lexer::state_markup_declaration_open,
+            action_markup_declaration);
+        all(html_lexer::state_raw_text, html_lexer::state_raw_text,
+            action_raw_text);
+
+        return t;
+    }
+};
+
+// html_dfa_tables - character classes and transitions of html_dfa
+class html_dfa_tables
+{
+private:
+    static constexpr html_dfa::tables _tables = html_dfa::build();
+
+public:
+    // get class of a character
+    static html_dfa::class_type get_class(char c)
+    {
+        return (html_dfa::class_type)_tables.classes[(unsigned char)c];
+    }
+
+    // get transition of a state on a class
+    static const html_dfa::transition &get_transition(
+        html_lexer::state_type state, html_dfa::class_type c)
+    {
+        return _tables.transitions[state][c];
+    }
+};
+
+#endif // __HTML_DFA__
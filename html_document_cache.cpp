@@ -0,0 +1,118 @@
+#include "html_document_cache.hpp"
+
+//
+// class html_document methods
+//
+
+// take html and tokenize it, build all indexes before the document is shared
+html_document::html_document(std::string &&html, uint64_t hash) :
+    _html(std::move(html)), _hash(hash)
+{
+    _lexer.tokenize_view(_html);
+
+    const html_token_store &store = _lexer.get_store();
+    store.build_match_table();
+    store.build_tag_index();
+    store.build_class_index();
+}
+
+//
+// class html_document_cache methods
+//
+
+// find document of html and mark it most recently used
+html_document_cache::document_ptr html_document_cache::find(
+    std::string_view html, uint64_t hash)
+{
+    auto range = _map.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        // a hash collision is not a hit
+        if ((*it->second)->get_html() == html)
+        {
+            _lru.splice(_lru.begin(), _lru, it->second);
+            return *it->second;
+        }
+    }
+
+    return nullptr;
+}
+
+// evict least recently used documents until bytes fit in budget
+void html_document_cache::evict()
+{
+    while (_bytes > _budget && !_lru.empty())
+    {
+        auto last = std::prev(_lru.end());
+        auto range = _map.equal_range((*last)->get_hash());
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == last)
+            {
+                _map.erase(it);
+                break;
+            }
+        }
+
+        _bytes -= (*last)->get_size_in_bytes();
+        _lru.erase(last);
+        ++_evictions;
+    }
+}
+
+// get tokenized document of html, from cache or tokenized now
+html_document_cache::document_ptr html_document_cache::get(
+    std::string_view html)
+{
+    uint64_t hash = html_content_hash(html);
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+
+        document_ptr document = find(html, hash);
+        if (document)
+        {
+            ++_hits;
+            return document;
+        }
+
+        ++_misses;
+    }
+
+    // tokenize without the lock, other threads keep hitting
+    document_ptr document =
+        std::make_shared<const html_document>(std::string(html), hash);
+    size_t bytes = document->get_size_in_bytes();
+    if (bytes > _budget) return document;
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // another thread cached the same html meanwhile, share its document
+    document_ptr cached = find(html, hash);
+    if (cached) return cached;
+
+    _lru.push_front(document);
+    _map.emplace(hash, _lru.begin());
+    _bytes += bytes;
+    evict();
+
+    return document;
+}
+
+// drop all documents, counters are kept
+void html_document_cache::clear()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _map.clear();
+    _lru.clear();
+    _bytes = 0;
+}
+
+// get counters and size
+html_document_cache::stats_type html_document_cache::get_stats()
+{
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    return {_hits, _misses, _evictions, _lru.size(), _bytes};
+}
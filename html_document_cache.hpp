@@ -0,0 +1,122 @@
+//
+// HTML Lexer - Document Cache
+// Tokenized documents shared by threads, keyed by content hash
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_DOCUMENT_CACHE__
+#define __HTML_DOCUMENT_CACHE__
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "html_lexer.hpp"
+
+//
+// html_document - a html and its tokens, immutable once constructed.
+//
+// The match table, tag index and class index are built by the constructor,
+// so the const queries of get_lexer() never build them lazily, and threads
+// can query a document at the same time.
+//
+class html_document
+{
+private:
+    std::string _html;
+    uint64_t    _hash;
+    html_lexer  _lexer;
+
+public:
+    // take html and tokenize it, hash is html_content_hash(html)
+    html_document(std::string &&html, uint64_t hash);
+
+    // non-copyable, tokens are spans of _html
+    html_document(const html_document &) = delete;
+    html_document &operator=(const html_document &) = delete;
+
+    std::string_view get_html() const {return _html;}
+    uint64_t get_hash() const {return _hash;}
+
+    // get tokens and queries, only const functions are safe on threads
+    const html_lexer &get_lexer() const {return _lexer;}
+
+    // return the bytes of html, tokens and indexes
+    size_t get_size_in_bytes() const
+    {
+        return _html.capacity() + _lexer.get_allocated_bytes() +
+               _lexer.get_store().get_index_bytes();
+    }
+};
+
+//
+// html_document_cache - tokenized documents by content hash, evicted by LRU.
+//
+// - get() hashes the html, and returns the cached document of the same
+//   content, or tokenizes a new one and caches it.
+// - Documents are shared by std::shared_ptr, an evicted document lives on
+//   until its last user drops it.
+// - The least recently used documents are evicted once the bytes of all
+//   documents exceed the budget. A document larger than the budget is
+//   returned without caching it.
+// - get() is safe on threads, the lock is held for lookup and insert only,
+//   a miss tokenizes outside of it.
+//
+class html_document_cache
+{
+public:
+    typedef std::shared_ptr<const html_document> document_ptr;
+
+    struct stats_type
+    {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        size_t   documents; // cached now
+        size_t   bytes;
+    };
+
+private:
+    // documents from most to least recently used, and by hash. documents
+    // of the same hash but different content are all in the map.
+    typedef std::list<document_ptr> lru_type;
+
+    std::mutex                                          _mutex;
+    lru_type                                            _lru;
+    std::unordered_multimap<uint64_t, lru_type::iterator> _map;
+
+    size_t _budget;
+    size_t _bytes;
+
+    uint64_t _hits;
+    uint64_t _misses;
+    uint64_t _evictions;
+
+    // find document of html and mark it most recently used, lock is held
+    document_ptr find(std::string_view html, uint64_t hash);
+
+    // evict least recently used documents until bytes fit in budget, lock
+    // is held
+    void evict();
+
+public:
+    // cache documents of up to budget bytes in total
+    explicit html_document_cache(size_t budget) :
+        _budget(budget), _bytes(0), _hits(0), _misses(0), _evictions(0) {}
+
+    // non-copyable, owns the lock
+    html_document_cache(const html_document_cache &) = delete;
+    html_document_cache &operator=(const html_document_cache &) = delete;
+
+    // get tokenized document of html, from cache or tokenized now
+    document_ptr get(std::string_view html);
+
+    // drop all documents, counters are kept
+    void clear();
+
+    // get counters and size
+    stats_type get_stats();
+};
+
+#endif // __HTML_DOCUMENT_CACHE__
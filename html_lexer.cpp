@@ -1,863 +1,1286 @@
+#include <algorithm> // lower_bound(), binary_search(), sort(), unique()
+#include <cstring>   // memcpy()
 #include "html_lexer.hpp"
+#include "html_scan.hpp"
+#include "html_writer.hpp"
 
-// compare string case insensitive
-static bool iequals(const std::string &str1, const std::string &str2)
+//
+// class html_token methods
+//
+
+// get tag name in lower case
+std::string html_token::get_name() const
+{
+    uint32_t name_id = _store->get_name_id(_pos);
+    if (name_id == html_token_store::no_name) return std::string();
+
+    return std::string(_store->get_name(name_id));
+}
+
+// get tag name as it is in original html
+std::string_view html_token::get_name_view() const
+{
+    uint32_t name_id = _store->get_name_id(_pos);
+    if (name_id == html_token_store::no_name) return std::string_view();
+
+    // name starts after "<" or "</"
+    size_t start = get_start_position();
+    start += get_type() == token_end_tag ? 2 : 1;
+
+    return _store->get_span(start, _store->get_name(name_id).size());
+}
+
+// get nth attribute
+html_token::attribute_type html_token::get_attribute(size_t pos) const
+{
+    auto &attribute =
+        _store->get_attribute(_store->get_attribute_begin(_pos) + pos);
+
+    return std::make_pair(
+        _store->get_span(attribute.name_start,  attribute.name_size),
+        _store->get_span(attribute.value_start, attribute.value_size));
+}
+
+// check if tag has specific classes
+bool html_token::has_classes(std::string_view classes) const
 {
-    if (str1.size() != str2.size())
+    if (get_type() != token_start_tag) return false;
+
+    // each class is in the sorted class ids of tag
+    auto ids = _store->get_class_ids(_pos);
+    size_t pos = 0;
+    for (auto class_name = html_token_store::next_class(classes, pos);
+         !class_name.empty();
+         class_name = html_token_store::next_class(classes, pos))
     {
-        return false;
+        uint32_t id = _store->find_class_id(class_name);
+        if (!std::binary_search(ids.begin(), ids.end(), id))
+        {
+            return false;
+        }
     }
 
-    auto c1  = str1.cbegin();
-    auto c2  = str2.cbegin();
-    auto end = str1.cend();
+    return true;
+}
+
+// check if tag has specific classes
+bool html_token::has_classes(
+    const std::set<std::string_view> &classes_set) const
+{
+    if (get_type() != token_start_tag) return false;
 
-    while (c1 != end)
+    auto ids = _store->get_class_ids(_pos);
+    for (auto it = classes_set.cbegin(); it != classes_set.cend(); ++it)
     {
-        if (tolower(*c1) != tolower(*c2))
+        uint32_t id = _store->find_class_id(*it);
+        if (!std::binary_search(ids.begin(), ids.end(), id))
         {
             return false;
         }
-
-        ++c1;
-        ++c2;
     }
 
     return true;
 }
 
-//
-// class html_start_tag_token methods
-//
-
-// lexer only, add new attribute and push temp attribute to attribute vector
-void html_start_tag_token::new_attribute()
+// get content of text, comment, bogus comment and raw text
+std::string_view html_token::get_readonly_content() const
 {
-    if (_attribute_name.size() != 0)
-    {
-        _attributes.push_back(
-            std::make_pair(_attribute_name, _attribute_value));
+    size_t start = get_start_position();
+    size_t end   = get_end_position();
 
-        if (_attribute_name == "class")
+    switch (get_type())
+    {
+    case token_comment:
+        // <!--...--> or <!--... cut by end of html
+        start += 4;
+        if (_store->get_flags(_pos) & html_token_store::flag_terminated)
         {
-            set_classes(_attribute_value);
+            end -= 3;
         }
-
-        _attribute_name.clear();
+        break;
+    case token_bogus_comment:
+    case token_text:
+    case token_raw_text:
+        break;
+    default:
+        return std::string_view();
     }
 
-    _attribute_value.clear();
+    return _store->get_span(start, end - start);
+}
+
+// print tokenized information
+void html_token::print() const
+{
+    std::string output;
+    html_token_writer::append(output, *this, html_token_writer::format_text);
+    std::cout << output;
 }
 
-// split classes into set
-void html_start_tag_token::split_classes_to_set(
-    const std::string &classes, std::set<std::string> &classes_set)
+// hash of html content, 8 bytes per step, a multiply and a shift mix each
+// word into the hash
+uint64_t html_content_hash(std::string_view html)
 {
-    size_t first;
-    size_t last = 0;
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ html.size();
 
-    while (last != std::string::npos)
+    size_t i = 0;
+    for (; i + 8 <= html.size(); i += 8)
     {
-        first = classes.find_first_not_of(" \n\r\t", last);
-        if (first == std::string::npos) break;
+        uint64_t word;
+        std::memcpy(&word, html.data() + i, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
 
-        last = classes.find_first_of(" \n\r\t", first + 1);
-        if (last == std::string::npos)
-        {
-            classes_set.insert(classes.substr(first));
-        }
-        else
-        {
-            classes_set.insert(classes.substr(first, last - first));
-        }
+    if (i < html.size())
+    {
+        uint64_t word = 0;
+        std::memcpy(&word, html.data() + i, html.size() - i);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+    }
+
+    return h;
+}
+
+//
+// class html_token_store methods
+//
+
+// clear tables and keep memory
+void html_token_store::clear()
+{
+    _html = std::string_view();
+    _base = 0;
+
+    _types.clear();
+    _flags.clear();
+    _starts.clear();
+    _ends.clear();
+    _names.clear();
+    _attribute_begins.clear();
+    _attributes.clear();
+    _matches.clear();
+    _tag_index_size = npos;
+    _class_index_size = npos;
+    for (auto slot : _name_positions)
+    {
+        _name_slots[slot] = 0;
     }
+    _name_table.clear();
+    _name_hashes.clear();
+    _name_positions.clear();
+    _arena.reset();
 }
 
-// check if tag has specific classes
-bool html_start_tag_token::has_classes(const std::string &classes)
+// clear tables for html and keep memory
+void html_token_store::reset(std::string_view html)
 {
-    std::set<std::string> classes_set;
-    split_classes_to_set(classes, classes_set);
+    clear();
+    _html = html;
 
-    return has_classes(classes_set);
+    // a token per 32 bytes is typical
+    reserve(html.size() / 32 + 64);
 }
 
-// check if tag has specific classes
-bool html_start_tag_token::has_classes(const std::set<std::string> &classes_set)
+// remove all rows, tag names are kept
+void html_token_store::discard_tokens()
 {
-    for (auto it = classes_set.cbegin(); it != classes_set.cend(); ++it)
+    _types.clear();
+    _flags.clear();
+    _starts.clear();
+    _ends.clear();
+    _names.clear();
+    _attribute_begins.clear();
+    _attributes.clear();
+    _matches.clear();
+    _tag_index_size = npos;
+    _class_index_size = npos;
+}
+
+// append rows from first of a store of the same html, names are interned
+// again in this store
+void html_token_store::append(const html_token_store &store, size_t first)
+{
+    if (first >= store.size()) return;
+
+    reserve(size() + store.size() - first);
+
+    size_t attributes = _attributes.size() +
+                        store._attributes.size() - store._attribute_begins[first];
+    if (attributes > _attributes.capacity())
     {
-        // TODO: case sensitive?
-        if (_classes.find(*it) == _classes.end())
+        _attributes.reserve(attributes);
+        ++_allocations;
+    }
+
+    auto intern = [&](uint32_t name_id)
+    {
+        return name_id < atom_count || name_id == no_name ?
+               name_id : intern_name(store.get_name(name_id));
+    };
+
+    for (size_t pos = first; pos < store.size(); ++pos)
+    {
+        size_t attribute_begin = _attributes.size();
+        for (size_t i = store.get_attribute_begin(pos);
+             i < store.get_attribute_end(pos); ++i)
         {
-            return false;
+            attribute_entry attribute = store._attributes[i];
+            attribute.name_id = intern(attribute.name_id);
+            _attributes.push_back(attribute);
         }
+
+        add_token(store.get_type(pos), store._flags[pos],
+                  store._starts[pos], store._ends[pos],
+                  intern(store._names[pos]), attribute_begin);
     }
+}
 
-    return true;
+// reserve token table
+void html_token_store::reserve(size_t size)
+{
+    if (size <= _types.capacity()) return;
+
+    _types.reserve(size);
+    _flags.reserve(size);
+    _starts.reserve(size);
+    _ends.reserve(size);
+    _names.reserve(size);
+    _attribute_begins.reserve(size);
+    _allocations += 6;
 }
 
-// print tokenized information
-void html_start_tag_token::print()
+// double _name_slots and place names again
+void html_token_store::grow_name_slots()
 {
-    std::cout << "[Start Tag      ] <" << get_name();
-    for (auto attribute : _attributes)
+    _name_slots.assign(_name_slots.empty() ? 64 : _name_slots.size() * 2, 0);
+
+    size_t mask = _name_slots.size() - 1;
+    for (size_t index = 0; index < _name_table.size(); ++index)
     {
-        std::cout << ' ' << attribute.first;
-        if (attribute.second.size() != 0)
+        size_t slot = _name_hashes[index] & mask;
+        while (_name_slots[slot] != 0)
         {
-            std::cout << "=\"" << attribute.second << "\"";
+            slot = (slot + 1) & mask;
         }
+
+        _name_slots[slot] = (uint32_t)index + 1;
+        _name_positions[index] = (uint32_t)slot;
+    }
+}
+
+// get name id of name, add it if not exists
+uint32_t html_token_store::intern_name(std::string_view name)
+{
+    // known names have fixed ids
+    uint32_t atom = html_atoms::find(name);
+    if (atom != html_atoms::none) return atom;
+
+    // at most half of slots are used
+    if ((_name_table.size() + 1) * 2 > _name_slots.size())
+    {
+        grow_name_slots();
     }
-    if (_is_self_closing)
+
+    uint32_t hash = html_atom_hash::hash(name);
+    size_t   slot = find_name_slot(name, hash);
+    if (_name_slots[slot] != 0)
     {
-        std::cout << "/";
+        return atom_count + _name_slots[slot] - 1;
     }
-    std::cout << ">\n";
-}
 
-//
-// class html_text_token methods
-//
+    // lower case name in arena
+    char *lower = _arena.allocate_array<char>(name.size());
+    for (size_t i = 0; i < name.size(); ++i)
+    {
+        lower[i] = tolower(name[i]);
+    }
 
-// lexer only, remove leading and trailing spaces
-void html_text_token::finalize()
-{
-    // remove leading spaces
-    auto pos = _data.find_first_not_of(" \n\r\t");
-    set_start_position(get_start_position() + pos);
-    _data.erase(0, pos);
+    _name_table.emplace_back(lower, name.size());
+    _name_hashes.push_back(hash);
+    _name_positions.push_back((uint32_t)slot);
+    _name_slots[slot] = (uint32_t)_name_table.size();
 
-    // remove trailing spaces
-    pos = _data.find_last_not_of(" \n\r\t");
-    set_end_position(get_end_position() - (_data.size() - pos - 1));
-    _data.erase(pos + 1, _data.size());
+    return atom_count + (uint32_t)_name_table.size() - 1;
 }
 
-//
-// class html_lexer methods
-//
+// get name id of name, return no_name if it is neither known nor in html
+uint32_t html_token_store::find_name_id(std::string_view name) const
+{
+    uint32_t atom = html_atoms::find(name);
+    if (atom != html_atoms::none) return atom;
+
+    if (_name_slots.empty()) return no_name;
+
+    size_t slot = find_name_slot(name, html_atom_hash::hash(name));
+    return _name_slots[slot] == 0 ?
+           no_name : atom_count + _name_slots[slot] - 1;
+}
 
-// add new token to token vector
-void html_lexer::emit_token(size_t token_end_position)
+// build match table in a stack pass.
+// tags are matched by name, a start tag is matched to the first end tag
+// which balances start and end tags of the name after it, as a stack per
+// name does. self-closing start tags are pushed too.
+void html_token_store::build_match_table() const
 {
-    if (_token != nullptr)
+    size_t size = _types.size();
+    _matches.resize(size);
+
+    // top of stack per name id, the stack is linked through _matches
+    auto &tops = _match_tops;
+    tops.assign(atom_count + _name_table.size(), (uint32_t)-1);
+
+    for (size_t i = 0; i < size; ++i)
     {
-        _token->set_end_position(token_end_position);
-        _token->finalize();
+        _matches[i] = (uint32_t)i; // no match
 
-        html_token::token_type type = _token->get_type();
-        if (type == html_token::token_start_tag)
+        if (_types[i] == html_token::token_start_tag)
         {
-            _tokens.push_back(_token);
-            std::string tag_name = ((html_tag_token *)_token)->get_name();
-            if (tag_name == "textarea" || tag_name == "style" ||
-                tag_name == "script"   || tag_name == "title" )
-            {
-                process_raw_text(tag_name);
-            }
+            // push
+            _matches[i] = tops[_names[i]];
+            tops[_names[i]] = (uint32_t)i;
         }
-        else if (type == html_token::token_text)
+        else if (_types[i] == html_token::token_end_tag)
         {
-            if (((html_text_token *)_token)->get_content_size() == 0)
-            {
-                delete _token;
-            }
-            else
+            // pop
+            uint32_t top = tops[_names[i]];
+            if (top != (uint32_t)-1)
             {
-                _tokens.push_back(_token);
+                tops[_names[i]] = _matches[top];
+                _matches[top] = (uint32_t)i;
+                _matches[i]   = top;
             }
         }
-        else
+    }
+
+    // start tags left on stacks have no match
+    for (auto top : tops)
+    {
+        while (top != (uint32_t)-1)
+        {
+            uint32_t next = _matches[top];
+            _matches[top] = top;
+            top = next;
+        }
+    }
+}
+
+// build tag index in a counting pass and a filling pass
+void html_token_store::build_tag_index() const
+{
+    size_t size = _types.size();
+    size_t keys = (atom_count + _name_table.size()) * 2;
+
+    // count tags per key, offsets are shifted by one for filling
+    _tag_offsets.assign(keys + 2, 0);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (_types[i] == html_token::token_start_tag)
+        {
+            ++_tag_offsets[(size_t)_names[i] * 2 + 2];
+        }
+        else if (_types[i] == html_token::token_end_tag)
+        {
+            ++_tag_offsets[(size_t)_names[i] * 2 + 3];
+        }
+    }
+
+    for (size_t key = 2; key < keys + 2; ++key)
+    {
+        _tag_offsets[key] += _tag_offsets[key - 1];
+    }
+
+    // fill positions in order, so they are sorted
+    _tag_positions.resize(_tag_offsets[keys + 1]);
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (_types[i] == html_token::token_start_tag)
+        {
+            _tag_positions[_tag_offsets[(size_t)_names[i] * 2 + 1]++] =
+                (uint32_t)i;
+        }
+        else if (_types[i] == html_token::token_end_tag)
+        {
+            _tag_positions[_tag_offsets[(size_t)_names[i] * 2 + 2]++] =
+                (uint32_t)i;
+        }
+    }
+
+    _tag_offsets.pop_back();
+    _tag_index_size = size;
+}
+
+// double _class_slots and place classes again
+void html_token_store::grow_class_slots() const
+{
+    _class_slots.assign(_class_slots.empty() ? 64 : _class_slots.size() * 2, 0);
+
+    size_t mask = _class_slots.size() - 1;
+    for (size_t index = 0; index < _class_names.size(); ++index)
+    {
+        size_t slot = _class_hashes[index] & mask;
+        while (_class_slots[slot] != 0)
         {
-            _tokens.push_back(_token);
+            slot = (slot + 1) & mask;
         }
 
-        // do not delete token here, as token is pushed into _tokens[]
-        _token = nullptr;
+        _class_slots[slot] = (uint32_t)index + 1;
     }
 }
 
-// process raw text
-void html_lexer::process_raw_text(const std::string &tag_name)
+// get class id of class, add it if not exists
+uint32_t html_token_store::intern_class(std::string_view class_name) const
 {
-    char c;
-    std::string name;
+    // at most half of slots are used
+    if ((_class_names.size() + 1) * 2 > _class_slots.size())
+    {
+        grow_class_slots();
+    }
+
+    uint32_t hash = html_atom_hash::hash(class_name);
+    size_t   slot = find_class_slot(class_name, hash);
+    if (_class_slots[slot] == 0)
+    {
+        _class_names.push_back(class_name);
+        _class_hashes.push_back(hash);
+        _class_slots[slot] = (uint32_t)_class_names.size();
+    }
+
+    return _class_slots[slot] - 1;
+}
 
-    auto size = tag_name.size();
-    if (size == 0) return;
+// build class index, intern classes of start tags, then fill positions of
+// each class in order
+void html_token_store::build_class_index() const
+{
+    size_t size = _types.size();
 
-    // move after '>'
-    auto pos = _idx + 1;
+    std::fill(_class_slots.begin(), _class_slots.end(), 0);
+    _class_names.clear();
+    _class_hashes.clear();
+    _class_ids.clear();
+    _class_offsets.resize(size + 1);
+    _class_offsets[0] = 0;
 
-    while (true)
+    for (size_t i = 0; i < size; ++i)
     {
-        // find position for possible end tag
-        pos = _html.find("</", pos);
-        if (pos != std::string::npos)
+        size_t begin = _class_ids.size();
+
+        if (_types[i] == html_token::token_start_tag)
         {
-            // match name
-            name = _html.substr(pos + 2, size);
-            if (iequals(tag_name, name))
+            for (size_t a = get_attribute_begin(i), end = get_attribute_end(i);
+                 a < end; ++a)
             {
-                // It is the end tag if the name is followed by '>' or space
-                c = _html[pos + 2 + size];
-                if (c == '>' || c == ' ' || c == '\n' || c == '\r' || c == '\t')
+                auto &attribute = _attributes[a];
+                if (attribute.name_id != atom_class) continue;
+
+                auto classes = get_span(attribute.value_start,
+                                        attribute.value_size);
+                size_t pos = 0;
+                for (auto class_name = next_class(classes, pos);
+                     !class_name.empty();
+                     class_name = next_class(classes, pos))
                 {
-                    break;
+                    _class_ids.push_back(intern_class(class_name));
                 }
             }
 
-            pos += 2;
-            continue;
+            // sorted and unique
+            std::sort(_class_ids.begin() + begin, _class_ids.end());
+            _class_ids.erase(
+                std::unique(_class_ids.begin() + begin, _class_ids.end()),
+                _class_ids.end());
         }
-        else
+
+        _class_offsets[i + 1] = (uint32_t)_class_ids.size();
+    }
+
+    // count tags per class, offsets are shifted by one for filling
+    size_t classes = _class_names.size();
+    _class_position_offsets.assign(classes + 2, 0);
+    for (auto id : _class_ids)
+    {
+        ++_class_position_offsets[id + 2];
+    }
+
+    for (size_t id = 2; id < classes + 2; ++id)
+    {
+        _class_position_offsets[id] += _class_position_offsets[id - 1];
+    }
+
+    // fill positions in order, so they are sorted
+    _class_positions.resize(_class_ids.size());
+    for (size_t i = 0; i < size; ++i)
+    {
+        for (size_t c = _class_offsets[i]; c < _class_offsets[i + 1]; ++c)
         {
-            // Not found, treat all other chars as raw text
-            pos = size;
+            _class_positions[_class_position_offsets[_class_ids[c] + 1]++] =
+                (uint32_t)i;
         }
-
-        break;
     }
 
-    if (pos != _idx + 1)
+    _class_position_offsets.pop_back();
+    _class_index_size = size;
+}
+
+// return the bytes reserved for tokens
+size_t html_token_store::get_allocated_bytes() const
+{
+    return _types.capacity() * 2 +
+           _starts.capacity() * sizeof(uint32_t) * 4 +
+           _attributes.capacity() * sizeof(attribute_entry) +
+           _arena.get_capacity();
+}
+
+// return the bytes reserved for match table, tag index and class index
+size_t html_token_store::get_index_bytes() const
+{
+    return (_matches.capacity() + _tag_offsets.capacity() +
+            _tag_positions.capacity() + _class_offsets.capacity() +
+            _class_ids.capacity() + _class_position_offsets.capacity() +
+            _class_positions.capacity() + _match_tops.capacity() +
+            _class_hashes.capacity() + _class_slots.capacity()) *
+           sizeof(uint32_t) +
+           _class_names.capacity() * sizeof(std::string_view);
+}
+
+//
+// class html_lexer methods
+//
+
+// start a new start/end tag
+void html_lexer::new_tag(html_token::token_type type)
+{
+    _token           = type;
+    _self_closing    = false;
+    _tag_name        = std::string_view();
+    _attribute_name  = std::string_view();
+    _attribute_value = std::string_view();
+    _attributes.clear();
+}
+
+// add new attribute and push temp attribute to attribute list
+void html_lexer::new_attribute()
+{
+    if (_token == html_token::token_start_tag && _attribute_name.size() != 0)
     {
-        ++_idx;
+        HTML_STATS(_stats.allocations +=
+                   _attributes.size() == _attributes.capacity();)
+
+        _attributes.emplace_back(_attribute_name, _attribute_value);
+    }
 
-        // emit raw text token
-        html_raw_text_token *token = new html_raw_text_token();
-        std::string raw_text = _html.substr(_idx, pos - _idx);
+    _attribute_name  = std::string_view();
+    _attribute_value = std::string_view();
+}
 
-        token->set_start_position(_idx);
-        token->set_end_position(pos);
-        token->set_content(raw_text);
-        token->finalize();
-        _tokens.push_back(token);
+// switch to raw text state after <textarea>, <style>, <script> and <title>
+void html_lexer::check_raw_text(uint32_t name_id)
+{
+    if (_token != html_token::token_start_tag) return;
 
-        _idx = pos - 1; // point to the char before '<' or the last char of html
+    switch (name_id)
+    {
+    case atom_textarea:
+    case atom_style:
+    case atom_script:
+    case atom_title:
+        _raw_text_tag = html_atoms::get_name(name_id);
+        _state = state_raw_text;
+        break;
+    default:
+        break;
     }
 }
 
-// process markup declaration, <!-- -->, <![CDATA[...]]>, or <!doctype>
-void html_lexer::process_markup_declaration(size_t tag_start_position)
+// extend span to the character before next c, skip the run with SIMD or
+// structural index
+void html_lexer::append_run(std::string_view &span, char c)
 {
-    if (_html[_idx] == '-' && _html[_idx + 1] == '-')
+    size_t next;
+    if (_use_index)
+    {
+        next = c == '<' ? _index.find_lt(_idx + 1) :
+                          _index.find_quote(_idx + 1, c);
+    }
+    else
     {
-        _token = new html_comment_token();
-        _token->set_start_position(_idx - 2);
+        next = _idx + 1 + html_scanner::find(
+            _html.data() + _idx + 1, _size - _idx - 1, c);
+    }
 
-        auto pos = _html.find("-->", _idx + 2);
-        std::string comment;
-        if (pos == std::string::npos)
-        {
-            comment = _html.substr(_idx + 2);
-            _idx = _size - 1; // point to the last char of html
-        }
-        else
-        {
-            comment = _html.substr(_idx + 2, pos - _idx - 2);
-            _idx = pos + 2; // point to '>'
-        }
-        ((html_comment_token *)_token)->set_content(comment);
+    extend_span(span, _html.data() + _idx, _html.data() + next - 1);
+    _idx = next - 1; // point to the last char of the run
+}
+
+// extend span to the character before next space, '/', '=' or '>'.
+// the per-byte engine extends span to the current character only.
+void html_lexer::append_delimited_run(std::string_view &span)
+{
+    if (_use_index)
+    {
+        size_t next = _index.find_delimiter(_idx + 1);
 
-        _state = state_data;
-        emit_token(_idx + 1);
+        extend_span(span, _html.data() + _idx, _html.data() + next - 1);
+        _idx = next - 1; // point to the last char of the run
+    }
+    else
+    {
+        extend_span(span, _html.data() + _idx);
     }
-    else if (_html.substr(_idx, 7) == "[CDATA[")
+}
+
+// find pattern "</", "-->", "]]>" or ">" from pos, return npos if not found
+size_t html_lexer::find(std::string_view pattern, size_t pos) const
+{
+    if (!_use_index)
     {
-        _token = new html_raw_text_token();
-        _token->set_start_position(tag_start_position);
+        return _html.find(pattern, pos);
+    }
 
-        auto pos = _html.find("]]>", _idx + 7);
-        std::string cdata;
-        if (pos == std::string::npos)
+    size_t size = pattern.size();
+    if (pattern.front() == '<')
+    {
+        // check candidates at '<'
+        for (size_t p = _index.find_lt(pos); p < _size;
+             p = _index.find_lt(p + 1))
         {
-            cdata = _html.substr(tag_start_position);
-            _idx = _size - 1; // point to the last char of html
+            if (_html.compare(p, size, pattern) == 0) return p;
         }
-        else
+    }
+    else
+    {
+        // check candidates ending at '>'
+        for (size_t p = _index.find_gt(pos + size - 1); p < _size;
+             p = _index.find_gt(p + 1))
         {
-            cdata = _html.substr(tag_start_position,
-                                 pos + 3 - tag_start_position);
-            _idx = pos + 2; // point to '>'
+            if (_html.compare(p + 1 - size, size, pattern) == 0)
+            {
+                return p + 1 - size;
+            }
         }
-        ((html_raw_text_token *)_token)->set_content(cdata);
-
-        _state = state_data;
-        emit_token(_idx + 1);
     }
-    else if (iequals(_html.substr(_idx, 7), "DOCTYPE"))
+
+    return std::string_view::npos;
+}
+
+// find pattern from pos, return npos if not found.
+// in push mode, the next search resumes where this search stopped.
+size_t html_lexer::find_resumable(std::string_view pattern, size_t pos)
+{
+    if (_search_pos > pos)
     {
-        std::string tag_name("!doctype");
-        _token = new html_start_tag_token();
-        _token->set_start_position(tag_start_position);
-        ((html_start_tag_token *)_token)->set_name(tag_name);
-        _idx += 6; // point to 'E'
-        _state = state_tag_name;
+        pos = _search_pos;
     }
-    else
+
+    auto found = find(pattern, pos);
+    if (found == std::string_view::npos)
     {
-        process_bogus_comment(tag_start_position);
+        // pattern may be cut by end of html, search its head again
+        _search_pos = _size - pos >= pattern.size() ?
+                      _size - pattern.size() + 1 : pos;
     }
+
+    return found;
 }
 
-// process bogus comment
-void html_lexer::process_bogus_comment(size_t tag_start_position)
+// reset state machine
+void html_lexer::reset(std::string_view html)
 {
-    // emit raw text token
-    html_bogus_comment_token *token = new html_bogus_comment_token();
-    token->set_start_position(tag_start_position);
+    _html       = html;
+    _size       = _html.size();
+    _base       = 0;
+    _idx        = 0;
+    _state      = state_data;
+    _tag_start  = 0;
+    _search_pos = 0;
+    _token      = html_token::token_null;
+    _text       = std::string_view();
+    _lazy       = false;
+    _pause      = false;
+    _sync_pos   = npos;
+
+    HTML_STATS(_stats = stats_type();)
+    HTML_STATS(_stats_allocation_base = _store.get_allocation_count();)
+}
+
+// the tag cut by end of html is not emitted
+void html_lexer::discard_tag()
+{
+    _token = html_token::token_null;
+    _attributes.clear();
+}
 
-    auto pos = _html.find(">", _idx);
-    if (pos == std::string::npos)
+// prepare to tokenize a whole html
+void html_lexer::begin_html(std::string_view html)
+{
+    // stage 1 of structural engine
+    _use_index = _engine == engine_structural;
+    if (_use_index)
     {
-        pos = _size - 1;
+        _index.build(html);
     }
 
-    std::string bogus_comment =
-        _html.substr(tag_start_position, pos - tag_start_position + 1);
-    token->set_end_position(pos + 1);
-    token->set_content(bogus_comment);
-    token->finalize();
-    _tokens.push_back(token);
+    _streaming = false;
+    _finished  = true;
+    reset(html);
+    _store.clear();
+}
 
-    _idx = pos; // point to '>' or the last char of html
-    _state = state_data;
+// finish tokenizing a whole html
+void html_lexer::end_html()
+{
+    discard_tag();
+    _use_index = false;
 }
 
-// tokenizer, state machine
+// tokenizer, state machine, tokenize a copy of html
 bool html_lexer::tokenize(const std::string &html)
 {
-    // reset state machine
-    _html  = html; // copy
-    _size  = _html.size();
-    _idx   = 0;
-    _state = state_data;
-    _token = nullptr;
-    clear_tokens();
-
-    size_t tag_start_position = 0;
-    char c;
+    _buffer = html; // copy
 
-    while (_idx < _size)
-    {
-        c = _html[_idx];
+    return tokenize_view(_buffer);
+}
 
-        switch (_state)
-        {
-        // http://www.w3.org/TR/html5/syntax.html#data-_state
-        case state_data:
-            // std::cerr << "state_data" << std::endl;
-            if (c == '<')
-            {
-                // remember tag open position
-                tag_start_position = _idx;
-                _state = state_tag_open;
-                emit_token(_idx);
-            }
-            else
-            {
-                if (_token == nullptr)
-                {
-                    _token = new html_text_token();
-                    _token->set_start_position(_idx);
-                }
+// tokenizer, state machine, take html and tokenize it
+bool html_lexer::tokenize(std::string &&html)
+{
+    _buffer = std::move(html);
 
-                ((html_text_token *)_token)->append_to_content(c);
-            }
-            break;
+    return tokenize_view(_buffer);
+}
 
-        // http://www.w3.org/TR/html5/syntax.html#tag-open-_state
-        case state_tag_open:
-            // std::cerr << "state_tag_open" << std::endl;
-            if (c == '!')
-            {
-                _state = state_markup_declaration_open;
-            }
-            else if (c == '/')
-            {
-                _state = state_end_tag_open;
-            }
-            else if (isupper(c))
-            {
-                _token = new html_start_tag_token();
-                _token->set_start_position(tag_start_position);
-                ((html_tag_token *)_token)->append_to_name(tolower(c));
-                _state = state_tag_name;
-            }
-            else if (islower(c))
-            {
-                _token = new html_start_tag_token();
-                _token->set_start_position(tag_start_position);
-                ((html_tag_token *)_token)->append_to_name(c);
-                _state = state_tag_name;
-            }
-            else if (c == '?')
-            {
-                _state = state_bogus_comment;
-            }
-            else
-            {
-                // parse error
-                _state = state_data;
-                continue; // reconsume current char
-            }
-            break;
+// tokenizer, state machine, tokenize html in place
+bool html_lexer::tokenize_view(std::string_view html)
+{
+    // positions are 32-bit in token table
+    if (html.size() > UINT32_MAX) return false;
 
-        // http://www.w3.org/TR/html5/syntax.html#end-tag-open-_state
-        case state_end_tag_open:
-            // std::cerr << "state_end_tag_open" << std::endl;
-            if (isupper(c))
-            {
-                _token = new html_end_tag_token();
-                _token->set_start_position(tag_start_position);
-                ((html_tag_token *)_token)->append_to_name(tolower(c));
-                _state = state_tag_name;
-            }
-            else if (islower(c))
-            {
-                _token = new html_end_tag_token();
-                _token->set_start_position(tag_start_position);
-                ((html_tag_token *)_token)->append_to_name(c);
-                _state = state_tag_name;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-            }
-            else
-            {
-                // parse error
-                _state = state_bogus_comment;
-            }
-            break;
+    begin_html(html);
+    _store.reset(html);
+    run(_store);
+    end_html();
 
-        // http://www.w3.org/TR/html5/syntax.html#tag-name-_state
-        case state_tag_name:
-            // std::cerr << "state_tag_name" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                _state = state_before_attribute_name;
-            }
-            else if (c == '/')
-            {
-                _state = state_self_closing_start_tag;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else if (isupper(c))
-            {
-                ((html_tag_token *)_token)->append_to_name(tolower(c));
-            }
-            else
-            {
-                ((html_tag_token *)_token)->append_to_name(c);
-            }
-            break;
+    return true;
+}
 
-        // http://www.w3.org/TR/html5/syntax.html#before-attribute-name-_state
-        case state_before_attribute_name:
-            // std::cerr << "state_before_attribute_name" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                // ignore
-            }
-            else if (c == '/')
-            {
-                _state = state_self_closing_start_tag;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else if (isupper(c))
-            {
-                ((html_tag_token *)_token)->new_attribute();
-                ((html_tag_token *)_token)->
-                    append_to_attribute_name(tolower(c));
-                _state = state_attribute_name;
-            }
-            else
-            {
-                // parse error
-                if (c == '"' || c == '\'' || c == '<' || c == '=')
-                {
-                    // treat it as attribute name
-                }
+// tokenizer, state machine, map a file and tokenize it in place
+bool html_lexer::tokenize_file(const std::string &path)
+{
+    // tokens of the previous mapping are dropped before unmapping it
+    begin_html(std::string_view());
 
-                ((html_tag_token *)_token)->new_attribute();
-                ((html_tag_token *)_token)->append_to_attribute_name(c);
-                _state = state_attribute_name;
-            }
-            break;
+    if (!_file.open(path, html_mapped_file::advice_sequential)) return false;
 
-        // http://www.w3.org/TR/html5/syntax.html#attribute-name-_state
-        case state_attribute_name:
-            // std::cerr << "state_attribute_name" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                _state = state_after_attribute_name;
-            }
-            else if (c == '/')
-            {
-                _state = state_self_closing_start_tag;
-            }
-            else if (c == '=')
-            {
-                _state = state_before_attribute_value;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else if (isupper(c))
-            {
-                ((html_tag_token *)_token)->
-                    append_to_attribute_name(tolower(c));
-            }
-            else
-            {
-                // parse error
-                if (c == '"' || c == '\'' || c == '<')
-                {
-                    // treat it as attribute name
-                }
+    return tokenize_view(_file.view());
+}
 
-                ((html_tag_token *)_token)->append_to_attribute_name(c);
-            }
-            break;
+// tokenizer, state machine, tokenize html in place on demand
+bool html_lexer::tokenize_lazy(std::string_view html)
+{
+    // positions are 32-bit in token table
+    if (html.size() > UINT32_MAX) return false;
 
-        // http://www.w3.org/TR/html5/syntax.html#after-attribute-name-_state
-        case state_after_attribute_name:
-            // std::cerr << "state_after_attribute_name" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                // ignore
-            }
-            else if (c == '/')
-            {
-                _state = state_self_closing_start_tag;
-            }
-            else if (c == '=')
-            {
-                _state = state_before_attribute_value;
-            }
-            else if (c =='>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else if (isupper(c))
-            {
-                ((html_tag_token *)_token)->new_attribute();
-                ((html_tag_token *)_token)->
-                    append_to_attribute_name(tolower(c));
-                _state = state_attribute_name;
-            }
-            else
-            {
-                // parse error
-                if (c == '"' || c == '\'' || c == '<')
-                {
-                    // treat it as attribute name
-                }
+    _use_index = false;
+    _streaming = false;
+    _finished  = true;
+    reset(html);
 
-                ((html_tag_token *)_token)->new_attribute();
-                ((html_tag_token *)_token)->append_to_attribute_name(c);
-                _state = state_attribute_name;
-            }
-            break;
+    // token table grows with tokens, not reserved for the whole html
+    _store.clear();
+    _store.move_html(html, 0);
 
-        // http://www.w3.org/TR/html5/syntax.html#before-attribute-value-_state
-        case state_before_attribute_value:
-            // std::cerr << "state_before_attribute_value" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                // ignore
-            }
-            else if (c == '"')
-            {
-                _state = state_attribute_value_double_quoted;
-            }
-            else if (c == '\'')
-            {
-                _state = state_attribute_value_single_quoted;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else
-            {
-                // parse error
-                if (c == '<' || c == '=' || c == '`')
-                {
-                    // but treat it as anything else
-                }
+    _lazy = true;
 
-                ((html_tag_token *)_token)->append_to_attribute_value(c);
-                _state = state_attribute_value_unquoted;
-            }
-            break;
+    return true;
+}
 
-        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(double-quoted)-_state
-        case state_attribute_value_double_quoted:
-            // std::cerr << "state_attribute_value_double_quoted" << std::endl;
-            if (c == '"')
-            {
-                _state = state_after_attribute_value_quoted;
-            }
-            else
-            {
-                ((html_tag_token *)_token)->append_to_attribute_value(c);
-            }
-            break;
+// lazy mode, tokenize until nth token exists
+bool html_lexer::pull(size_t pos)
+{
+    pause_handler handler = {*this};
 
-        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(single-quoted)-_state
-        case state_attribute_value_single_quoted:
-            // std::cerr << "state_attribute_value_single_quoted" << std::endl;
-            if (c == '\'')
-            {
-                _state = state_after_attribute_value_quoted;
-            }
-            else
-            {
-                ((html_tag_token *)_token)->append_to_attribute_value(c);
-            }
-            break;
+    while (_lazy && _store.size() <= pos)
+    {
+        _pause = false;
+        run(handler);
 
-        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(unquoted)-_state
-        case state_attribute_value_unquoted:
-            // std::cerr << "state_attribute_value_unquoted" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                _state = state_before_attribute_name;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else
-            {
-                // parse error
-                if (c == '"' || c == '\'' || c == '<' || c == '=' || c == '`')
-                {
-                    // but treat it as anything else
-                }
+        if (_idx >= _size)
+        {
+            end_html();
+            _lazy = false;
+        }
+    }
+    _pause = false;
 
-                ((html_tag_token *)_token)->append_to_attribute_value(c);
-            }
-            break;
+    return pos < _store.size();
+}
 
-        // http://www.w3.org/TR/html5/syntax.html#after-attribute-value-(quoted)-_state
-        case state_after_attribute_value_quoted:
-            // std::cerr << "state_after_attribute_value_quoted" << std::endl;
-            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
-            {
-                _state = state_before_attribute_name;
-            }
-            else if (c == '/')
-            {
-                _state = state_self_closing_start_tag;
-            }
-            else if (c == '>')
-            {
-                _state = state_data;
-                emit_token(_idx + 1);
-            }
-            else
-            {
-                _state = state_before_attribute_name;
-                continue; // reconsume the character
-            }
-            break;
+// parallel mode, tokenize html from start until the first '<' in data state
+// from sync_pos or end of html
+void html_lexer::tokenize_chunk(std::string_view html, size_t start,
+                                size_t sync_pos)
+{
+    _use_index = false;
+    _streaming = false;
+    _finished  = true;
+    reset(html);
+
+    _idx         = start;
+    _tag_start   = start;
+    _chunk_start = start;
+    _sync_pos    = sync_pos;
+
+    // a token per 32 bytes is typical
+    size_t end = sync_pos < _size ? sync_pos : _size;
+    _store.clear();
+    _store.move_html(html, 0);
+    _store.reserve((end - start) / 32 + 64);
+
+    run(_store);
+    if (!_pause)
+    {
+        end_html();
+    }
+}
 
-        // http://www.w3.org/TR/html5/syntax.html#self-closing-start-tag-_state
-        case state_self_closing_start_tag:
-            // std::cerr << "state_self_closing_start_tag" << std::endl;
-            if (c == '>')
-            {
-                _state = state_data;
-                ((html_tag_token *)_token)->set_self_closing();
-                emit_token(_idx + 1);
-            }
-            else
-            {
-                // parse error
-                _state = state_before_attribute_name;
-                continue; // reconsume the character
-            }
-            break;
-        case state_bogus_comment:
-            process_bogus_comment(tag_start_position);
-            break;
-        case state_markup_declaration_open:
-            process_markup_declaration(tag_start_position);
-            break;
-        default:
-            // std::cerr << "what is this?" << std::endl;
-            break;
-        }
+// parallel mode, continue to the next '<' in data state
+bool html_lexer::resume_chunk()
+{
+    if (!_pause) return false;
 
-        ++_idx; // consume next char
+    _pause    = false;
+    _sync_pos = _idx; // the char after '<'
+    run(_store);
+
+    if (!_pause)
+    {
+        end_html();
+        return false;
     }
 
     return true;
 }
 
-// get nth token, return nullptr if out of range
-html_token *html_lexer::get_token(size_t pos)
+// parallel mode, the chunk starts in data state, and tags, comments and
+// bogus comments start at '<' in data state
+bool html_lexer::is_sync_point(size_t pos) const
 {
-    size_t size = _tokens.size();
-    if (pos >= size) return nullptr;
+    if (pos == _chunk_start) return true;
 
-    return _tokens[pos];
-}
+    auto &starts = _store._starts;
+    auto it = std::lower_bound(starts.begin(), starts.end(), (uint32_t)pos);
+    for (; it != starts.end() && *it == pos; ++it)
+    {
+        // raw text may start with '<' in raw text state
+        if (_store.get_type(it - starts.begin()) != html_token::token_raw_text)
+        {
+            return true;
+        }
+    }
 
+    return false;
+}
 
-// find tag by name, return npos if not found
-size_t html_lexer::find_tag_by_name(
-    const std::string &tag_name, bool start_tag, size_t pos)
+// tokenizer, state machine, tokenize html in place on threads of pool
+bool html_lexer::tokenize_parallel(std::string_view html,
+                                   html_thread_pool &pool,
+                                   size_t min_chunk_size)
 {
-    size_t size = _tokens.size();
-    if (pos >= size) return npos;
+    // positions are 32-bit in token table
+    if (html.size() > UINT32_MAX) return false;
 
-    html_token *token;
-    html_token::token_type type;
-    for (size_t idx = pos; idx < size; ++idx)
+    size_t size  = html.size();
+    size_t count = pool.size();
+    if (min_chunk_size > 0 && size / min_chunk_size < count)
     {
-        token = _tokens[idx];
-        type = token->get_type();
-        if ( ( start_tag && type == html_token::token_start_tag) ||
-             (!start_tag && type == html_token::token_end_tag  ) )
+        count = size / min_chunk_size;
+    }
+
+    // chunks start at the first '<' after even split points
+    std::vector<size_t> starts(1, 0);
+    for (size_t i = 1; i < count; ++i)
+    {
+        size_t pos = i * (size / count);
+        pos += html_scanner::find(html.data() + pos, size - pos, '<');
+        if (pos < size && pos > starts.back())
         {
-            if (iequals(((html_tag_token *)token)->get_name(), tag_name))
-            {
-                return idx;
-            }
+            starts.push_back(pos);
+        }
+    }
+
+    count = starts.size();
+    if (count == 1)
+    {
+        return tokenize_view(html);
+    }
+    starts.push_back(size); // the last chunk runs to end of html
+
+    while (_chunks.size() < count)
+    {
+        _chunks.emplace_back(new html_lexer());
+    }
+
+    pool.parallel_for(count, [&](size_t i)
+    {
+        _chunks[i]->tokenize_chunk(html, starts[i], starts[i + 1]);
+    });
+
+    // the first chunk is exact. the next chunk is exact from the first '<'
+    // both are in data state at, the exact chunk continues until then, and
+    // a chunk is skipped if the exact chunk passes its end.
+    _use_index = false;
+    _streaming = false;
+    _finished  = true;
+    reset(html);
+    _store.reset(html);
+
+    html_lexer *exact = _chunks[0].get();
+    size_t      first = 0; // first token of exact chunk
+    bool        done  = !exact->_pause;
+
+    for (size_t i = 1; i < count && !done; ++i)
+    {
+        html_lexer *chunk = _chunks[i].get();
+        size_t      end   = chunk->get_chunk_end();
+
+        while (!done && exact->_tag_start < end &&
+               (exact->_tag_start < starts[i] ||
+                !chunk->is_sync_point(exact->_tag_start)))
+        {
+            done = !exact->resume_chunk();
         }
+
+        if (done || exact->_tag_start >= end) continue;
+
+        // tokens before the '<' are from exact chunk, and the rest from
+        // this chunk
+        auto &chunk_starts = chunk->_store._starts;
+        size_t sync = exact->_tag_start;
+
+        _store.append(exact->_store, first);
+        first = std::lower_bound(chunk_starts.begin(), chunk_starts.end(),
+                                 (uint32_t)sync) - chunk_starts.begin();
+        exact = chunk;
+        done  = !exact->_pause;
     }
 
-    return npos;
+    _store.append(exact->_store, first);
+
+#ifdef HTML_LEXER_STATS
+    // work of all chunks, including tokens dropped at seams
+    for (size_t i = 0; i < count; ++i)
+    {
+        add_stats(_chunks[i]->get_stats());
+    }
+#endif
+
+    return true;
 }
 
-// find tag by name and classes, return npos if not found
-size_t html_lexer::find_tag_by_class_names(
-    const std::string &tag_name, const std::string &classes, size_t pos)
+// push mode, tokenize next chunk of html
+bool html_lexer::feed(const char *html, size_t size)
 {
-    size_t size = _tokens.size();
-    if (pos >= size) return npos;
+    if (!_streaming)
+    {
+        _buffer.clear();
+        reset(_buffer);
+        _store.reset(_buffer);
+        _streaming = true;
+        _finished  = false;
+    }
+
+    // positions are 32-bit in token table
+    if (_base + _buffer.size() + size > UINT32_MAX) return false;
 
-    html_token *token;
-    html_token::token_type type;
-    std::set<std::string> classes_set;
-    html_start_tag_token::split_classes_to_set(classes, classes_set);
+    const char *data = _buffer.data();
+    _buffer.append(html, size);
+    HTML_STATS(_stats.allocations += data != _buffer.data();)
+    move_buffer(data, 0);
+
+    run(_store);
+    deliver_tokens();
+
+    return true;
+}
 
-    for (size_t idx = pos; idx < size; ++idx)
+// push mode, tokenize the rest of html
+bool html_lexer::finish()
+{
+    if (!_streaming)
     {
-        token = _tokens[idx];
-        type = token->get_type();
-        if (type == html_token::token_start_tag)
+        _buffer.clear();
+        reset(_buffer);
+        _store.reset(_buffer);
+    }
+
+    _finished = true;
+    run(_store);
+    discard_tag();
+    deliver_tokens();
+
+    _streaming = false;
+
+    return true;
+}
+
+// views of _buffer point to its new data, after shift bytes are erased
+void html_lexer::move_buffer(const char *data, size_t shift)
+{
+    auto move = [&](std::string_view &span)
+    {
+        if (!span.empty())
         {
-            if (iequals(((html_start_tag_token *)token)->get_name(), tag_name)
-                && ((html_start_tag_token *)token)->has_classes(classes_set))
-            {
-                return idx;
-            }
+            span = std::string_view(
+                _buffer.data() + (span.data() - data) - shift, span.size());
+        }
+    };
+
+    // a tag with many attributes stays pending across chunks, only move
+    // its views when they are stale
+    if (data != _buffer.data() || shift != 0)
+    {
+        move(_text);
+        move(_tag_name);
+        move(_attribute_name);
+        move(_attribute_value);
+        for (auto &attribute : _attributes)
+        {
+            move(attribute.first);
+            move(attribute.second);
         }
     }
 
-    return npos;
+    _html = _buffer;
+    _size = _buffer.size();
+    _store.move_html(_html, _base);
 }
 
-// find matching tag of nth tag
-// return pos, if nth tag is self-closing tag or no match tag
-// return position before pos, if nth tag is close tag
-// return position after pos, if nth tag is start tag
-size_t html_lexer::find_matching_tag(size_t pos)
+// push mode, pass complete tokens to handler, then drop them and the html
+// before the token in progress
+void html_lexer::deliver_tokens()
 {
-    size_t size = _tokens.size();
-    if (pos >= size) return npos;
+    if (!_handler) return;
 
-    html_token *token = _tokens[pos];
-    html_token::token_type type = token->get_type();
-    std::string tag_name;
-    html_token *token2;
-    html_token::token_type type2;
-    size_t depth = 0;
+    for (size_t pos = 0; pos < _store.size(); ++pos)
+    {
+        _handler(_store.get_token(pos));
+    }
 
-    if (type == html_token::token_start_tag)
+    _store.discard_tokens();
+
+    // the first char still needed
+    size_t keep = _idx;
+    if (_state != state_data && _state != state_raw_text && _tag_start < keep)
     {
-        if (((html_start_tag_token *)token)->get_self_closing())
-        {
-            return pos;
-        }
+        keep = _tag_start;
+    }
+    if (!_text.empty() && (size_t)(_text.data() - _html.data()) < keep)
+    {
+        keep = _text.data() - _html.data();
+    }
 
-        tag_name = ((html_tag_token *)token)->get_name();
+    if (keep == 0) return;
 
-        for (size_t i = pos + 1; i < size; ++i)
-        {
-            token2 = _tokens[i];
-            type2 = token2->get_type();
-            if (type2 == html_token::token_start_tag)
-            {
-                if (((html_tag_token *)token2)->get_name() == tag_name)
-                {
-                    ++depth;
-                }
-            }
-            else if (type2 == html_token::token_end_tag)
-            {
-                if (((html_tag_token *)token2)->get_name() == tag_name)
-                {
-                    if (depth == 0)
-                    {
-                        return i;
-                    }
+    const char *data = _buffer.data();
+    _buffer.erase(0, keep);
+    _base += keep;
+    _idx  -= keep;
+    _tag_start  = _tag_start  > keep ? _tag_start  - keep : 0;
+    _search_pos = _search_pos > keep ? _search_pos - keep : 0;
+    move_buffer(data, keep);
+}
 
-                    --depth;
-                }
-            }
-        }
+// get hot path statistics of the last html
+html_lexer::stats_type html_lexer::get_stats() const
+{
+    stats_type stats = _stats;
+    HTML_STATS(stats.allocations +=
+               _store.get_allocation_count() - _stats_allocation_base;)
+
+    return stats;
+}
+
+// add statistics of another lexer
+void html_lexer::add_stats(const stats_type &stats)
+{
+    for (size_t i = 0; i < state_count; ++i)
+    {
+        _stats.state_bytes[i] += stats.state_bytes[i];
+    }
+    for (size_t i = 0; i <= html_token::token_raw_text; ++i)
+    {
+        _stats.tokens[i] += stats.tokens[i];
+    }
+    for (size_t i = 0; i < time_count; ++i)
+    {
+        _stats.process_ns[i] += stats.process_ns[i];
+    }
+    _stats.transitions += stats.transitions;
+    _stats.allocations += stats.allocations;
+}
+
+// get name of a state
+const char *html_lexer::get_state_name(state_type state)
+{
+    static const char *names[state_count] =
+    {
+        "data",
+        "tag_open",
+        "end_tag_open",
+        "tag_name",
+        "self_closing_start_tag",
+        "before_attribute_name",
+        "attribute_name",
+        "after_attribute_name",
+        "before_attribute_value",
+        "attribute_value_unquoted",
+        "attribute_value_single_quoted",
+        "attribute_value_double_quoted",
+        "after_attribute_value_quoted",
+        "bogus_comment",
+        "markup_declaration_open",
+        "raw_text"
+    };
+
+    return state < state_count ? names[state] : "unknown";
+}
+
+// print tokenized information, the writer flushes the buffer by a single
+// write() per megabyte instead of a stream insertion per field
+void html_lexer::print() const
+{
+    // keep order with output already in std::cout
+    std::cout.flush();
+
+    html_token_writer writer;
+    writer.write(_store);
+    writer.flush();
+}
+
+// print hot path statistics of the last html
+void html_lexer::print_stats() const
+{
+    static const char *token_names[] =
+        {"null", "start tag", "end tag", "comment", "bogus comment", "text",
+         "raw text"};
+    static const char *time_names[time_count] =
+        {"raw text", "markup declaration", "bogus comment"};
+
+    stats_type stats = get_stats();
+
+    std::cerr << "[Lexer Stats     ] " << stats.transitions << " transitions, "
+              << stats.allocations << " allocations\n";
+
+    for (size_t i = 0; i < state_count; ++i)
+    {
+        if (stats.state_bytes[i] == 0) continue;
+
+        std::cerr << "[Lexer Stats     ] " << stats.state_bytes[i]
+                  << " bytes in state " << get_state_name((state_type)i)
+                  << '\n';
     }
-    else if (type == html_token::token_end_tag)
+
+    for (size_t i = 1; i <= html_token::token_raw_text; ++i)
     {
-        tag_name = ((html_tag_token *)token)->get_name();
+        std::cerr << "[Lexer Stats     ] " << stats.tokens[i] << " "
+                  << token_names[i] << " tokens\n";
+    }
 
-        if (pos == 0) return 0;
+    for (size_t i = 0; i < time_count; ++i)
+    {
+        std::cerr << "[Lexer Stats     ] " << stats.process_ns[i] / 1000
+                  << " us in " << time_names[i] << '\n';
+    }
+}
 
-        for (size_t i = pos - 1; i != npos; --i)
-        {
-            token2 = _tokens[i];
-            type2 = token2->get_type();
-            if (type2 == html_token::token_start_tag)
-            {
-                if (((html_tag_token *)token2)->get_name() == tag_name)
-                {
-                    if (depth == 0)
-                    {
-                        return i;
-                    }
+// get nth token, return nullptr if out of range
+html_token html_lexer::get_token(size_t pos) const
+{
+    if (pos >= _store.size()) return html_token();
 
-                    --depth;
-                }
-            }
-            else if (type2 == html_token::token_end_tag)
-            {
-                if (((html_tag_token *)token2)->get_name() == tag_name)
-                {
-                    ++depth;
-                }
-            }
+    return _store.get_token(pos);
+}
+
+// find tag by name, return npos if not found
+size_t html_lexer::find_tag_by_name(
+    std::string_view tag_name, bool start_tag, size_t pos) const
+{
+    auto positions = find_all_tags_by_name(tag_name, start_tag);
+
+    // the first position not before pos
+    auto it = std::lower_bound(positions.begin(), positions.end(), pos);
+    return it == positions.end() ? npos : *it;
+}
+
+// get positions of all start/end tags of a name
+html_token_store::position_range html_lexer::find_all_tags_by_name(
+    std::string_view tag_name, bool start_tag) const
+{
+    return _store.get_tag_positions(_store.find_name_id(tag_name), start_tag);
+}
+
+// find tag by name and classes, return npos if not found
+size_t html_lexer::find_tag_by_class_names(
+    std::string_view tag_name, std::string_view classes, size_t pos) const
+{
+    if (pos >= _store.size()) return npos;
+
+    uint32_t name_id = _store.find_name_id(tag_name);
+    if (name_id == html_token_store::no_name) return npos;
+
+    // positions of the tag, and of each class
+    std::vector<html_token_store::position_range> lists;
+    lists.push_back(_store.get_tag_positions(name_id, true));
+
+    size_t next = 0;
+    for (auto class_name = html_token_store::next_class(classes, next);
+         !class_name.empty();
+         class_name = html_token_store::next_class(classes, next))
+    {
+        uint32_t class_id = _store.find_class_id(class_name);
+        if (class_id == html_token_store::no_name) return npos;
+
+        lists.push_back(_store.get_class_positions(class_id));
+    }
+
+    // intersect sorted lists, skip to the largest candidate until all lists
+    // agree on it
+    size_t agreed = 0;
+    for (size_t i = 0; agreed < lists.size(); i = (i + 1) % lists.size())
+    {
+        auto it = std::lower_bound(lists[i].begin(), lists[i].end(), pos);
+        if (it == lists[i].end()) return npos;
+
+        if (*it == pos)
+        {
+            ++agreed;
+        }
+        else
+        {
+            pos = *it;
+            agreed = 1;
         }
     }
 
     return pos;
 }
+
+// find matching tag of nth tag
+// return pos, if nth tag is self-closing tag or no match tag
+// return position before pos, if nth tag is close tag
+// return position after pos, if nth tag is start tag
+size_t html_lexer::find_matching_tag(size_t pos) const
+{
+    if (pos >= _store.size()) return npos;
+
+    if (_store.get_type(pos) == html_token::token_start_tag &&
+        (_store.get_flags(pos) & html_token_store::flag_self_closing))
+    {
+        return pos;
+    }
+
+    // lookup match table
+    return _store.get_matching_tag(pos);
+}
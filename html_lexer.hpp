@@ -11,18 +11,69 @@
 #ifndef __HTML_LEXER__
 #define __HTML_LEXER__
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <set>
 #include <iostream>
 #include <cctype> // tolower(), isupper(), islower()
+#include <functional>
+#include <iterator>
+#include <memory>
+#include "html_arena.hpp"
+#include "html_atom.hpp"
+#include "html_mmap.hpp"
+#include "html_scan.hpp"
+#include "html_selector.hpp"
+#include "html_thread_pool.hpp"
+
+// hot path statistics of html_lexer, collected only if compiled with
+// -DHTML_LEXER_STATS, otherwise the statements are removed
+#ifdef HTML_LEXER_STATS
+#include <chrono>
+#define HTML_STATS(statement) statement
+#else
+#define HTML_STATS(statement)
+#endif
 
 class html_lexer;
+class html_token_store;
 
-// abstract base class for html tokens
+// compare string case insensitive
+inline bool html_iequals(std::string_view str1, std::string_view str2)
+{
+    if (str1.size() != str2.size())
+    {
+        return false;
+    }
+
+    auto c1  = str1.cbegin();
+    auto c2  = str2.cbegin();
+    auto end = str1.cend();
+
+    while (c1 != end)
+    {
+        if (tolower(*c1) != tolower(*c2))
+        {
+            return false;
+        }
+
+        ++c1;
+        ++c2;
+    }
+
+    return true;
+}
+
+// hash of html content, to tell documents apart without comparing them
+uint64_t html_content_hash(std::string_view html);
+
+// html token, a lightweight view of a row of html_token_store
 class html_token
 {
     friend class html_lexer;
+    friend class html_token_writer;
 
 public:
     enum token_type
@@ -36,255 +87,590 @@ public:
         token_raw_text
     };
 
-private:
-    // the position [start, end) of the token in original html
-    size_t _start;
-    size_t _end;
+    // attribute name and value, spans of original html
+    typedef std::pair<std::string_view, std::string_view> attribute_type;
 
-    // the type of token
-    token_type _type;
+private:
+    // the store and the index of token in it
+    const html_token_store *_store;
+    size_t                  _pos;
 
-    // html_lexer only, process token before emitting
-    virtual void finalize() = 0;
+public:
+    html_token() : _store(nullptr), _pos(0) {}
+    html_token(const html_token_store *store, size_t pos) :
+        _store(store), _pos(pos) {}
 
-protected:
-    // set token type, only visible by subtype
-    void set_type(token_type type) {_type = type;}
+    // a token out of range is null, compare it with nullptr
+    bool operator==(std::nullptr_t) const {return _store == nullptr;}
+    bool operator!=(std::nullptr_t) const {return _store != nullptr;}
+    explicit operator bool() const {return _store != nullptr;}
 
-    // html_lexer only, set position [start, end) of original html
-    // class html_text_token could reset positon on trim leading/trailing spaces
-    void set_start_position(size_t pos) {_start = pos;}
-    void set_end_position(size_t pos) {_end = pos;}
+    // pointer-like access, e.g. lexer.get_token(pos)->get_type()
+    const html_token *operator->() const {return this;}
 
-public:
-    html_token() : _start(0), _end(0), _type(token_null) {}
-    virtual ~html_token() {} // to invoke delete from base class
+    // get the index of token
+    size_t get_index() const {return _pos;}
 
     // get token type
-    token_type get_type() {return _type;}
+    token_type get_type() const;
 
     // get position [start, end) of original html
-    size_t get_start_position() {return _start;}
-    size_t get_end_position() {return _end;}
+    size_t get_start_position() const;
+    size_t get_end_position() const;
+
+    // start/end tag, get tag name in lower case, the name is materialized
+    std::string get_name() const;
+
+    // start/end tag, get tag name as it is in original html
+    std::string_view get_name_view() const;
+
+    // start/end tag, get name id, html_atom for known names
+    uint32_t get_name_id() const;
+
+    // start tag, get self-closing
+    bool get_self_closing() const;
+
+    // start tag, get attributes, names are not lower cased
+    size_t get_attribute_count() const;
+    attribute_type get_attribute(size_t pos) const;
+
+    // start tag, check if tag has specific classes
+    bool has_classes(std::string_view classes) const;
+    bool has_classes(const std::set<std::string_view> &classes_set) const;
+
+    // text, comment, bogus comment and raw text, get content without copying
+    std::string_view get_readonly_content() const;
+
+    // get a copy of content
+    std::string get_content() const
+    {
+        return std::string(get_readonly_content());
+    }
+
+    // get content size
+    size_t get_content_size() const {return get_readonly_content().size();}
 
     // print tokenized information
-    virtual void print() = 0;
+    void print() const;
 
     // print token in original html
-    void print(const std::string &html)
+    void print(std::string_view html) const
     {
-        std::cerr << '[' << _start << ", " << _end << ") "
-                  << html.substr(_start, _end - _start) << '\n';
+        size_t start = get_start_position();
+        size_t end   = get_end_position();
+        std::cerr << '[' << start << ", " << end << ") "
+                  << html.substr(start, end - start) << '\n';
     }
 };
 
-// abstract class for start and end tag tokens
-class html_tag_token : public html_token
+// a start/end tag passed to a visitor, valid during the call only.
+// the name and attributes are spans of original html, not lower cased.
+struct html_tag
+{
+    size_t                              start; // position [start, end)
+    size_t                              end;
+    std::string_view                    name;
+    uint32_t                            name_id; // html_atom, or none
+    const html_token::attribute_type   *attributes;
+    size_t                              attribute_count;
+    bool                                self_closing;
+};
+
+// a text, comment, bogus comment or raw text passed to a visitor, valid
+// during the call only. content is html_token::get_readonly_content().
+struct html_content
+{
+    html_token::token_type type;
+    size_t                 start; // position [start, end)
+    size_t                 end;
+    std::string_view       content;
+    bool                   terminated; // comment <!--...-->
+};
+
+// visitor of html_lexer::tokenize(html, handler). a handler derives from
+// it and hides the functions it needs, calls are resolved at compile time.
+struct html_visitor
+{
+    void on_start_tag(const html_tag &) {}
+    void on_end_tag(const html_tag &) {}
+    void on_text(const html_content &) {}
+    void on_comment(const html_content &) {} // comment and bogus comment
+    void on_raw_text(const html_content &) {}
+};
+
+// tokens of a html in parallel arrays, a row per token.
+// positions are offsets of original html, all strings are spans of it.
+// in push mode, _html holds the html from offset _base only.
+class html_token_store
 {
     friend class html_lexer;
+    friend class html_token_cache;
+
+public:
+    // token flags
+    enum flag_type
+    {
+        flag_self_closing = 1, // start tag <.../>
+        flag_terminated   = 2  // comment <!--...-->, not cut by end of html
+    };
+
+    // name id of text, comment and raw text tokens
+    static const uint32_t no_name = -1;
+
+    // no index is built
+    static const size_t npos = -1;
+
+    // positions of tokens in an index, sorted
+    struct position_range
+    {
+        const uint32_t *first;
+        const uint32_t *last;
+
+        const uint32_t *begin() const {return first;}
+        const uint32_t *end() const {return last;}
+        size_t size() const {return last - first;}
+        bool empty() const {return first == last;}
+    };
+
+    // an attribute, spans [start, start + size) of original html, and the
+    // name id of lower case name
+    struct attribute_entry
+    {
+        uint32_t name_id;
+        uint32_t name_start;
+        uint32_t name_size;
+        uint32_t value_start;
+        uint32_t value_size;
+    };
 
 private:
-    // the name of start/end tag
-    std::string _tag_name;
+    // original html
+    std::string_view _html;
+    size_t           _base;
+
+    // token table
+    std::vector<uint8_t>  _types;            // html_token::token_type
+    std::vector<uint8_t>  _flags;            // flag_type
+    std::vector<uint32_t> _starts;           // position [start, end)
+    std::vector<uint32_t> _ends;
+    std::vector<uint32_t> _names;            // name id of tag
+    std::vector<uint32_t> _attribute_begins; // index of first attribute
+
+    // attribute table, attributes of token i are
+    // [_attribute_begins[i], _attribute_begins[i + 1])
+    std::vector<attribute_entry> _attributes;
+
+    // name ids of known tag and attribute names are their atoms, other
+    // lower case names are interned per html, their name ids are
+    // atom_count + index of _name_table, strings are in _arena.
+    // _name_slots is an open addressing table of index + 1 of _name_table,
+    // 0 if empty, its size is a power of 2. a name is in slot
+    // _name_positions[index], so clearing costs the names, not the table.
+    std::vector<std::string_view> _name_table;
+    std::vector<uint32_t>         _name_hashes; // html_atom_hash::hash()
+    std::vector<uint32_t>         _name_positions;
+    std::vector<uint32_t>         _name_slots;
+    html_arena                    _arena;
+
+    // heap allocations of growing tables
+    size_t _allocations;
+
+    // match table, index of matching tag of each token, built on first use.
+    // _match_tops is the top of stack per name id while building.
+    mutable std::vector<uint32_t> _matches;
+    mutable std::vector<uint32_t> _match_tops;
+
+    // tag index, positions of start/end tags by name id, built on first use.
+    // positions of key (name id * 2 + is end tag) are
+    // [_tag_offsets[key], _tag_offsets[key + 1]) of _tag_positions.
+    mutable std::vector<uint32_t> _tag_offsets;
+    mutable std::vector<uint32_t> _tag_positions;
+    mutable size_t                _tag_index_size; // tokens indexed
+
+    // class index, classes are interned per html as class ids, the spans
+    // of html in _class_names. _class_slots is an open addressing table of
+    // class id + 1 as _name_slots. class ids of token i are
+    // [_class_offsets[i], _class_offsets[i + 1]) of _class_ids, sorted.
+    // positions of start tags with class id c are
+    // [_class_position_offsets[c], _class_position_offsets[c + 1]) of
+    // _class_positions. built on first use.
+    mutable std::vector<std::string_view> _class_names;
+    mutable std::vector<uint32_t> _class_hashes; // html_atom_hash::hash()
+    mutable std::vector<uint32_t> _class_slots;
+    mutable std::vector<uint32_t> _class_offsets;
+    mutable std::vector<uint32_t> _class_ids;
+    mutable std::vector<uint32_t> _class_position_offsets;
+    mutable std::vector<uint32_t> _class_positions;
+    mutable size_t                _class_index_size; // tokens indexed
+
+    // html_lexer only, clear tables and keep memory
+    void clear();
+    void reset(std::string_view html);
+
+    // html_lexer only, html moved or html before base dropped in push mode
+    void move_html(std::string_view html, size_t base)
+    {
+        _html = html;
+        _base = base;
+    }
 
-    // html_lexer only, append character to name
-    void append_to_name(char c) {_tag_name.push_back(c);}
+    // find the slot of name in _name_slots, or the empty slot to add it
+    size_t find_name_slot(std::string_view name, uint32_t hash) const
+    {
+        size_t mask = _name_slots.size() - 1;
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+        {
+            uint32_t index = _name_slots[slot];
+            if (index == 0 ||
+                (_name_hashes[index - 1] == hash &&
+                 html_iequals(_name_table[index - 1], name)))
+            {
+                return slot;
+            }
+        }
+    }
 
-    // the lexer accept self-closing for both start and end tag.
-    // end tag should override the function, emit error or omit it.
-    virtual void set_self_closing() = 0;
+    // double _name_slots and place names again
+    void grow_name_slots();
 
-    // html_lexer only, add new attribute
-    virtual void new_attribute() = 0;
+    // find the slot of class in _class_slots, or the empty slot to add it
+    size_t find_class_slot(std::string_view class_name, uint32_t hash) const
+    {
+        size_t mask = _class_slots.size() - 1;
+        for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+        {
+            uint32_t index = _class_slots[slot];
+            if (index == 0 ||
+                (_class_hashes[index - 1] == hash &&
+                 _class_names[index - 1] == class_name))
+            {
+                return slot;
+            }
+        }
+    }
 
-    // html_lexer only, append character to attribute name/value
-    virtual void append_to_attribute_name(char c) = 0;
-    virtual void append_to_attribute_value(char c) = 0;
+    // double _class_slots and place classes again
+    void grow_class_slots() const;
 
-protected:
-    // set tag name
-    void set_name(const std::string &name) {_tag_name = name;}
+    // get class id of class, add it if not exists
+    uint32_t intern_class(std::string_view class_name) const;
 
-public:
-    // get tag name
-    const std::string get_name() {return _tag_name;}
-};
+    // html_lexer only, get name id of name, add it if not exists
+    uint32_t intern_name(std::string_view name);
 
-// start tag token
-class html_start_tag_token : public html_tag_token
-{
-    friend class html_lexer;
+    // html_lexer only, the store is the visitor building token table
+    void on_start_tag(const html_tag &tag)
+    {
+        add_tag(html_token::token_start_tag, tag);
+    }
+    void on_end_tag(const html_tag &tag)
+    {
+        add_tag(html_token::token_end_tag, tag);
+    }
+    void on_text(const html_content &content) {add_content(content);}
+    void on_comment(const html_content &content) {add_content(content);}
+    void on_raw_text(const html_content &content) {add_content(content);}
 
-private:
-    // attributes
-    std::vector<std::pair<std::string, std::string>> _attributes;
+    // add a row of tag and its attributes
+    void add_tag(html_token::token_type type, const html_tag &tag)
+    {
+        size_t attribute_begin = _attributes.size();
+        for (size_t i = 0; i < tag.attribute_count; ++i)
+        {
+            add_attribute(tag.attributes[i].first, tag.attributes[i].second);
+        }
 
-    // html_lexer only, temp variables for attribute name/value
-    std::string _attribute_name;
-    std::string _attribute_value;
+        uint32_t name_id = tag.name_id != html_atoms::none ?
+                           tag.name_id : intern_name(tag.name);
+        add_token(type, tag.self_closing ? flag_self_closing : 0,
+                  tag.start, tag.end, name_id, attribute_begin);
+    }
 
-    // classes, class="..."
-    std::set<std::string> _classes;
+    // add a row of text, comment, bogus comment or raw text
+    void add_content(const html_content &content)
+    {
+        add_token(content.type, content.terminated ? flag_terminated : 0,
+                  content.start, content.end, no_name, _attributes.size());
+    }
 
-    // self-closing
-    bool _is_self_closing;
+    // add a row
+    void add_token(html_token::token_type type, uint8_t flags,
+                   size_t start, size_t end, uint32_t name,
+                   size_t attribute_begin)
+    {
+        if (_types.size() == _types.capacity())
+        {
+            reserve(_types.capacity() * 2 + 64);
+        }
 
-    // html_lexer only, set self-closing
-    void set_self_closing() {_is_self_closing = true;}
+        _types.push_back((uint8_t)type);
+        _flags.push_back(flags);
+        _starts.push_back((uint32_t)start);
+        _ends.push_back((uint32_t)end);
+        _names.push_back(name);
+        _attribute_begins.push_back((uint32_t)attribute_begin);
+    }
 
-    // set classes
-    void set_classes(const std::string &classes)
+    // add an attribute of the next token
+    void add_attribute(std::string_view name, std::string_view value)
     {
-        split_classes_to_set(classes, _classes);
+        if (_attributes.size() == _attributes.capacity())
+        {
+            _attributes.reserve(_attributes.capacity() * 2 + 64);
+            ++_allocations;
+        }
+
+        _attributes.push_back({intern_name(name),
+                               offset(name),  (uint32_t)name.size(),
+                               offset(value), (uint32_t)value.size()});
     }
 
-    // html_lexer only, add new attribute and push temp attribute to attributes
-    void new_attribute();
+    // html_lexer only, remove all rows passed to handler in push mode
+    void discard_tokens();
 
-    // html_lexer only, append character to attribute name/value
-    void append_to_attribute_name(char c) {_attribute_name.push_back(c);}
-    void append_to_attribute_value(char c) {_attribute_value.push_back(c);}
+    // html_lexer only, append rows from first of a store of the same html,
+    // names are interned again in this store
+    void append(const html_token_store &store, size_t first);
 
-    // html_lexer only, before emitting, push new attribute into set
-    void finalize() {new_attribute();}
+    // reserve token table
+    void reserve(size_t size);
 
-    // static function, split classes into set
-    static void split_classes_to_set(
-        const std::string &classes, std::set<std::string> &classes_set);
+    // offset of a span in html
+    uint32_t offset(std::string_view span)
+    {
+        return span.empty() ?
+               0 : (uint32_t)(_base + (span.data() - _html.data()));
+    }
 
 public:
-    html_start_tag_token() : _is_self_closing(false)
+    html_token_store() :
+        _base(0), _allocations(0), _tag_index_size(npos),
+        _class_index_size(npos) {}
+
+    html_token_store(const html_token_store &) = delete;
+    html_token_store &operator=(const html_token_store &) = delete;
+
+    // get original html
+    std::string_view get_html() const {return _html;}
+
+    // return the number of tokens
+    size_t size() const {return _types.size();}
+
+    // get nth token
+    html_token get_token(size_t pos) const {return html_token(this, pos);}
+
+    // get columns of nth token
+    html_token::token_type get_type(size_t pos) const
     {
-        set_type(token_start_tag);
+        return (html_token::token_type)_types[pos];
     }
+    uint8_t get_flags(size_t pos) const {return _flags[pos];}
+    size_t get_start_position(size_t pos) const {return _starts[pos];}
+    size_t get_end_position(size_t pos) const {return _ends[pos];}
+    uint32_t get_name_id(size_t pos) const {return _names[pos];}
 
-    // get self-closing
-    bool get_self_closing() {return _is_self_closing;}
+    // get attribute range [begin, end) of nth token in attribute table
+    size_t get_attribute_begin(size_t pos) const
+    {
+        return _attribute_begins[pos];
+    }
+    size_t get_attribute_end(size_t pos) const
+    {
+        return pos + 1 < _attribute_begins.size() ?
+               _attribute_begins[pos + 1] : _attributes.size();
+    }
 
-    // check if tag has specific classes
-    bool has_classes(const std::string &classes);
-    bool has_classes(const std::set<std::string> &classes_set);
+    // get an attribute in attribute table
+    const attribute_entry &get_attribute(size_t idx) const
+    {
+        return _attributes[idx];
+    }
 
-    // print tokenized information
-    void print();
-};
+    // get lower case name of a name id
+    std::string_view get_name(uint32_t name_id) const
+    {
+        return name_id < atom_count ? html_atoms::get_name(name_id) :
+                                      _name_table[name_id - atom_count];
+    }
 
-// end tag token
-class html_end_tag_token : public html_tag_token
-{
-    friend class html_lexer;
+    // get name id of name, return no_name if it is neither known nor in html
+    uint32_t find_name_id(std::string_view name) const;
 
-private:
-    // html_lexer only, end tag should not have attribute, omit if any.
-    void new_attribute() {} // parse error
-    void append_to_attribute_name(char c) {} // parse error
-    void append_to_attribute_value(char c) {} // parse error
+    // build match table in a stack pass, it is built on first use of
+    // get_matching_tag(), build it before sharing the store by threads
+    void build_match_table() const;
 
-    // html_lexer only, end tag should not self-closing
-    void set_self_closing() {} // parse error
+    // get matching tag of nth token, return pos if none
+    size_t get_matching_tag(size_t pos) const
+    {
+        if (_matches.size() != _types.size())
+        {
+            build_match_table();
+        }
 
-    // html_lexer only, nothing to finalize for end tag
-    void finalize() {}
+        return _matches[pos];
+    }
 
-public:
-    html_end_tag_token() {set_type(token_end_tag);}
+    // build tag index in a counting pass and a filling pass, it is built on
+    // first use of get_tag_positions(), build it before sharing the store
+    // by threads
+    void build_tag_index() const;
 
-    // print tokenized information
-    void print()
+    // get positions of start/end tags of a name id
+    position_range get_tag_positions(uint32_t name_id, bool start_tag) const
     {
-        std::cout << "[End Tag        ] </" << get_name() << ">\n";
+        if (_tag_index_size != _types.size())
+        {
+            build_tag_index();
+        }
+
+        size_t key = (size_t)name_id * 2 + (start_tag ? 0 : 1);
+        if (name_id == no_name || key + 1 >= _tag_offsets.size())
+        {
+            return {nullptr, nullptr};
+        }
+
+        const uint32_t *positions = _tag_positions.data();
+        return {positions + _tag_offsets[key], positions + _tag_offsets[key + 1]};
     }
-};
 
-// abstract class for text and comment tokens
-class html_data_token : public html_token
-{
-    friend class html_lexer;
+    // get next class of a space separated class list from pos, return empty
+    // if none
+    static std::string_view next_class(std::string_view classes, size_t &pos)
+    {
+        size_t first = classes.find_first_not_of(" \n\r\t", pos);
+        if (first == std::string_view::npos)
+        {
+            pos = classes.size();
+            return std::string_view();
+        }
 
-private:
-    // html_lexer only, set content
-    void set_content(const std::string &content) {_data = content;}
+        size_t last = classes.find_first_of(" \n\r\t", first + 1);
+        pos = last == std::string_view::npos ? classes.size() : last;
+        return classes.substr(first, pos - first);
+    }
 
-    // html_lexer only, by default nothing to finalize for data token
-    void finalize() {}
+    // build class index, classes of class attributes of start tags are
+    // split and interned. it is built on first use of the functions below,
+    // build it before sharing the store by threads
+    void build_class_index() const;
 
-protected:
-    // text or comment
-    std::string _data;
+    // get class id of a class, case sensitive, return no_name if no tag
+    // has the class
+    uint32_t find_class_id(std::string_view class_name) const
+    {
+        if (_class_index_size != _types.size())
+        {
+            build_class_index();
+        }
 
-public:
-    // get content
-    const std::string &get_readonly_content() {return _data;}
+        if (_class_slots.empty()) return no_name;
 
-    // get content size
-    size_t get_content_size() {return _data.size();}
-};
+        size_t slot = find_class_slot(class_name,
+                                      html_atom_hash::hash(class_name));
+        return _class_slots[slot] == 0 ? no_name : _class_slots[slot] - 1;
+    }
 
-// comment token
-class html_comment_token : public html_data_token
-{
-public:
-    html_comment_token() {set_type(token_comment);}
+    // get sorted class ids of nth token
+    position_range get_class_ids(size_t pos) const
+    {
+        if (_class_index_size != _types.size())
+        {
+            build_class_index();
+        }
 
-    // print tokenized information
-    void print()
+        const uint32_t *ids = _class_ids.data();
+        return {ids + _class_offsets[pos], ids + _class_offsets[pos + 1]};
+    }
+
+    // get positions of start tags with a class id
+    position_range get_class_positions(uint32_t class_id) const
     {
-        std::cout << "[Comment        ] <!--"
-                  << get_readonly_content() << "-->\n";
+        if (_class_index_size != _types.size())
+        {
+            build_class_index();
+        }
+
+        if (class_id == no_name) return {nullptr, nullptr};
+
+        const uint32_t *positions = _class_positions.data();
+        return {positions + _class_position_offsets[class_id],
+                positions + _class_position_offsets[class_id + 1]};
     }
-};
 
-// bogus comment token
-class html_bogus_comment_token : public html_data_token
-{
-public:
-    html_bogus_comment_token() {set_type(token_bogus_comment);}
+    // get a span of original html
+    std::string_view get_span(size_t start, size_t size) const
+    {
+        return size == 0 ?
+               std::string_view() : _html.substr(start - _base, size);
+    }
 
-    // print tokenized information
-    void print()
+    // return the number of heap allocations for tokens
+    size_t get_allocation_count() const
     {
-        std::cout << "[Bogus Comment  ] " << get_readonly_content() << '\n';
+        return _allocations + _arena.get_allocation_count();
     }
+
+    // return the bytes reserved for tokens
+    size_t get_allocated_bytes() const;
+
+    // return the bytes reserved for match table, tag index and class index
+    size_t get_index_bytes() const;
 };
 
-// text token
-class html_text_token : public html_data_token
+//
+// class html_token inline methods
+//
+
+inline html_token::token_type html_token::get_type() const
 {
-    friend class html_lexer;
+    return _store->get_type(_pos);
+}
 
-private:
-    // html_lexer only, append character to text
-    void append_to_content(char c) {_data.push_back(c);}
+inline size_t html_token::get_start_position() const
+{
+    return _store->get_start_position(_pos);
+}
 
-    // html_lexer only, remove leading and trailing spaces
-    void finalize();
+inline size_t html_token::get_end_position() const
+{
+    return _store->get_end_position(_pos);
+}
 
-public:
-    html_text_token() {set_type(token_text);}
+inline uint32_t html_token::get_name_id() const
+{
+    return _store->get_name_id(_pos);
+}
 
-    // print tokenized information
-    void print()
-    {
-        std::cout << "[Text           ] " << get_readonly_content() << '\n';
-    }
-};
+inline bool html_token::get_self_closing() const
+{
+    return (_store->get_flags(_pos) & html_token_store::flag_self_closing) != 0;
+}
+
+inline size_t html_token::get_attribute_count() const
+{
+    return _store->get_attribute_end(_pos) - _store->get_attribute_begin(_pos);
+}
 
-// raw text token
-class html_raw_text_token : public html_data_token
+class html_lexer
 {
 public:
-    html_raw_text_token() {set_type(token_raw_text);}
+    // tokenizer engine
+    enum engine_type
+    {
+        engine_state_machine, // state machine, skip text/values with SIMD
+        engine_structural     // state machine fed by a structural index
+    };
 
-    // print tokenized information
-    void print()
+    // timed process_...() functions of stats
+    enum time_type
     {
-        std::cout << "[Raw Text       ] " << get_readonly_content() << '\n';
-    }
-};
+        time_raw_text,
+        time_markup_declaration, // includes bogus comments it finds
+        time_bogus_comment,
+        time_count
+    };
 
-class html_lexer
-{
-private:
     // state
     enum state_type
     {
@@ -302,11 +688,32 @@ private:
         state_attribute_value_double_quoted,
         state_after_attribute_value_quoted,
         state_bogus_comment,
-        state_markup_declaration_open
+        state_markup_declaration_open,
+        state_raw_text,
+        state_count
     };
 
-    // a copy of html
-    std::string _html;
+    // hot path statistics of the last html, all zero unless compiled with
+    // -DHTML_LEXER_STATS
+    struct stats_type
+    {
+        uint64_t state_bytes[state_count];     // bytes consumed per state
+        uint64_t transitions;                  // state changes
+        uint64_t tokens[html_token::token_raw_text + 1]; // tokens per type
+        uint64_t allocations;                  // heap allocations
+        uint64_t process_ns[time_count];    // time in process_...()
+    };
+
+private:
+    // a copy of html, used when tokenize() is called with std::string,
+    // or the html not yet consumed in push mode
+    std::string _buffer;
+
+    // a file mapped by tokenize_file()
+    html_mapped_file _file;
+
+    // the html being tokenized, _buffer, _file or a buffer owned by caller
+    std::string_view _html;
 
     // the size of html
     size_t _size;
@@ -318,89 +725,470 @@ private:
     // state machine state
     state_type _state;
 
-    // new token
-    html_token *_token;
+    // position of '<' of current tag, comment or markup declaration
+    size_t _tag_start;
+
+    // name of tag whose raw text is being processed
+    std::string_view _raw_text_tag;
+
+    // push mode, _html starts at offset _base of the whole html, and the
+    // html ends only after finish(). a search waiting for more characters
+    // resumes from _search_pos.
+    bool   _streaming;
+    bool   _finished;
+    size_t _base;
+    size_t _search_pos;
+
+    // push mode, complete tokens are passed to handler then dropped
+    std::function<void(const html_token &)> _handler;
+
+    // lazy mode, html is tokenized on demand, and the state machine pauses
+    // after each token
+    bool _lazy;
+    bool _pause;
+
+    // parallel mode, a chunk is tokenized from _chunk_start and the state
+    // machine pauses at the first '<' in data state from _sync_pos.
+    // _chunks are the lexers of chunks, kept for next html.
+    size_t                                   _chunk_start;
+    size_t                                   _sync_pos;
+    std::vector<std::unique_ptr<html_lexer>> _chunks;
+
+    // new start/end tag, token_null if none
+    html_token::token_type _token;
+    bool                   _self_closing;
+    std::string_view       _tag_name;
+
+    // temp variables for attribute name/value of new tag, and attributes
+    // of new tag, memory is kept for next tag
+    std::string_view                        _attribute_name;
+    std::string_view                        _attribute_value;
+    std::vector<html_token::attribute_type> _attributes;
+
+    // pending text, text token is created only if it is not empty
+    std::string_view _text;
 
     // all tokens
-    std::vector<html_token *> _tokens;
+    html_token_store _store;
+
+    // statistics of the last html, and allocations of token store before
+    stats_type _stats;
+    size_t     _stats_allocation_base;
+
+    // tokenizer engine, and stage 1 of the structural engine
+    engine_type           _engine;
+    html_structural_index _index;
+    bool                  _use_index;
+
+    // extend span to the characters [first, last], spans are always contiguous
+    static void extend_span(std::string_view &span,
+                            const char *first, const char *last)
+    {
+        if (span.empty())
+        {
+            span = std::string_view(first, last - first + 1);
+        }
+        else
+        {
+            span = std::string_view(span.data(), last - span.data() + 1);
+        }
+    }
+
+    // extend span to the character at p
+    static void extend_span(std::string_view &span, const char *p)
+    {
+        extend_span(span, p, p);
+    }
 
-    // finalize new token and add it to token vector
-    void emit_token(size_t token_end_position);
+    // extend span to the character before next c, or the last character of
+    // html, move _idx to the last character of the run
+    void append_run(std::string_view &span, char c);
 
-    // release memory
-    void clear_tokens()
+    // extend span to the character before next space, '/', '=' or '>'
+    void append_delimited_run(std::string_view &span);
+
+    // find "</", "-->", "]]>" or ">" from pos, return npos if not found
+    size_t find(std::string_view pattern, size_t pos) const;
+
+    // find pattern from pos, in push mode the next search resumes where
+    // this search stopped
+    size_t find_resumable(std::string_view pattern, size_t pos);
+
+    // start a new start/end tag
+    void new_tag(html_token::token_type type);
+
+    // add new attribute and push temp attribute to attribute list
+    // end tag should not have attribute, omit if any.
+    void new_attribute();
+
+    // the lexer accept self-closing for both start and end tag.
+    // end tag should not self-closing, omit it.
+    void set_self_closing()
     {
-        for (auto token : _tokens)
+        if (_token == html_token::token_start_tag)
         {
-            delete token;
+            _self_closing = true;
         }
-        _tokens.clear();
     }
 
-    // process raw text
-    void process_raw_text(const std::string &tag_name);
+    // finalize new tag and pass it to handler
+    template <typename Handler>
+    void emit_token(Handler &handler, size_t token_end_position);
+
+    // pass text to handler if pending text is not only spaces
+    template <typename Handler>
+    void emit_text(Handler &handler);
+
+    // switch to raw text state after <textarea>, <style>, <script> and
+    // <title>, name_id is the atom of tag name
+    void check_raw_text(uint32_t name_id);
+
+    // process raw text of <textarea>, <style>, <script> and <title>
+    // in push mode, return false if more characters are needed
+    template <typename Handler>
+    bool process_raw_text(Handler &handler);
 
     // process markup declaration, <!-- -->, <![CDATA[...]]>, or <!doctype>
-    void process_markup_declaration(size_t tag_start_position);
+    // in push mode, return false if more characters are needed
+    template <typename Handler>
+    bool process_markup_declaration(Handler &handler);
 
     // process bogus comment <!...> or <?...>
-    void process_bogus_comment(size_t tag_start_position);
+    // in push mode, return false if more characters are needed
+    template <typename Handler>
+    bool process_bogus_comment(Handler &handler);
+
+    // reset state machine
+    void reset(std::string_view html);
+
+    // run state machine until end of html or more characters are needed,
+    // the engine is run_dfa() if HTML_LEXER_DFA is defined, or run_switch()
+    template <typename Handler>
+    void run(Handler &handler);
+
+    // state machine of switch on state and if-chains on character
+    template <typename Handler>
+    void run_switch(Handler &handler);
+
+    // state machine of html_dfa tables, one lookup of character class and
+    // one of transition per character, then a jump on action
+    template <typename Handler>
+    void run_dfa(Handler &handler);
+
+    // prepare and finish tokenizing a whole html
+    void begin_html(std::string_view html);
+    void end_html();
+
+    // drop the tag cut by end of html
+    void discard_tag();
+
+    // push mode, update views after _buffer is reallocated or its first
+    // shift bytes are erased
+    void move_buffer(const char *data, size_t shift);
+
+    // push mode, pass complete tokens to handler and drop consumed html
+    void deliver_tokens();
+
+    // lazy mode, add tokens to token table and pause after each token
+    struct pause_handler
+    {
+        html_lexer &lexer;
+
+        void on_start_tag(const html_tag &tag)
+        {
+            lexer._store.on_start_tag(tag);
+            lexer._pause = true;
+        }
+        void on_end_tag(const html_tag &tag)
+        {
+            lexer._store.on_end_tag(tag);
+            lexer._pause = true;
+        }
+        void on_text(const html_content &content)
+        {
+            lexer._store.on_text(content);
+            lexer._pause = true;
+        }
+        void on_comment(const html_content &content)
+        {
+            lexer._store.on_comment(content);
+            lexer._pause = true;
+        }
+        void on_raw_text(const html_content &content)
+        {
+            lexer._store.on_raw_text(content);
+            lexer._pause = true;
+        }
+    };
+
+    // lazy mode, tokenize until nth token exists.
+    // return false if html ends before it.
+    bool pull(size_t pos);
+
+    // parallel mode, tokenize html from start, until the first '<' in data
+    // state from sync_pos or end of html
+    void tokenize_chunk(std::string_view html, size_t start, size_t sync_pos);
+
+    // parallel mode, continue to the next '<' in data state, return false
+    // if html ends before it
+    bool resume_chunk();
+
+    // parallel mode, the '<' the state machine paused at, or end of html.
+    // tokens of chunk are [_chunk_start, get_chunk_end()) of html.
+    size_t get_chunk_end() const {return _pause ? _tag_start : _size;}
+
+    // parallel mode, check if the state machine was in data state at '<'
+    // of pos, where a token of chunk starts
+    bool is_sync_point(size_t pos) const;
+
+#ifdef HTML_LEXER_STATS
+    // count bytes consumed and transitions of states while run() is in
+    // scope, count() is called before each character
+    struct state_counter
+    {
+        html_lexer &lexer;
+        size_t      idx;
+        state_type  state;
+
+        state_counter(html_lexer &l) : lexer(l), idx(l._idx), state(l._state) {}
+        ~state_counter() {count();}
+
+        void count()
+        {
+            lexer._stats.state_bytes[state] += lexer._idx - idx;
+            if (lexer._state != state) ++lexer._stats.transitions;
+
+            idx   = lexer._idx;
+            state = lexer._state;
+        }
+    };
+
+    // add the time in scope to a counter of process_...()
+    struct process_timer
+    {
+        uint64_t                             &ns;
+        std::chrono::steady_clock::time_point start;
+
+        process_timer(uint64_t &n) :
+            ns(n), start(std::chrono::steady_clock::now()) {}
+        ~process_timer()
+        {
+            ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+    };
+#endif
+
+    // add statistics of another lexer, e.g. a chunk in parallel mode
+    void add_stats(const stats_type &stats);
 
 public:
     // constructor
-    html_lexer() {};
-    html_lexer(const std::string &html) {tokenize(html);}
+    html_lexer() :
+        _streaming(false), _finished(true), _base(0),
+        _lazy(false), _pause(false), _sync_pos(npos),
+        _token(html_token::token_null),
+        _stats(), _stats_allocation_base(0),
+        _engine(engine_state_machine), _use_index(false) {};
+    html_lexer(const std::string &html) :
+        _streaming(false), _finished(true), _base(0),
+        _lazy(false), _pause(false), _sync_pos(npos),
+        _token(html_token::token_null),
+        _stats(), _stats_allocation_base(0),
+        _engine(engine_state_machine), _use_index(false)
+    {
+        tokenize(html);
+    }
 
-    // destructor
-    ~html_lexer() {clear_tokens();}
+    // non-copyable, tokens are spans of _buffer
+    html_lexer(const html_lexer &) = delete;
+    html_lexer &operator=(const html_lexer &) = delete;
 
     // npos for not found
     static const size_t npos = -1;
 
-    // tokenizer, state machine
+    // tokenizer, state machine, tokenize a copy of html. the token tables
+    // and the copy keep their memory for the next html, so a lexer reused
+    // for many htmls allocates only when a html is larger than all before.
     bool tokenize(const std::string &html);
 
+    // tokenizer, state machine, take html without copying it
+    bool tokenize(std::string &&html);
+
+    // tokenizer, state machine, tokenize html in place without copying.
+    // the buffer is owned by caller and must outlive the tokens, as all
+    // names, attributes and contents are spans of it.
+    bool tokenize_view(std::string_view html);
+
+    // tokenizer, state machine, map a file read-only and tokenize it in
+    // place, the file is never copied to heap. the mapping is kept until
+    // the next tokenize_file() or the lexer is destroyed. return false if
+    // the file cannot be mapped or exceeds 4GB.
+    bool tokenize_file(const std::string &path);
+
+    // tokenizer, state machine, tokenize html in place on demand. tokens
+    // are tokenized one at a time while iterating from begin() to end(),
+    // other functions see the tokens tokenized so far. lazy mode always
+    // uses the state machine engine.
+    bool tokenize_lazy(std::string_view html);
+
+    // forward iterator over tokens, tokenizes next token on demand
+    class iterator
+    {
+    private:
+        html_lexer *_lexer;
+        size_t      _pos;
+
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef html_token                value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef const html_token         *pointer;
+        typedef html_token                reference;
+
+        iterator(html_lexer *lexer, size_t pos) : _lexer(lexer), _pos(pos)
+        {
+            if (_pos != npos && !_lexer->pull(_pos)) _pos = npos;
+        }
+
+        html_token operator*() const {return _lexer->_store.get_token(_pos);}
+        html_token operator->() const {return **this;}
+
+        iterator &operator++()
+        {
+            if (!_lexer->pull(++_pos)) _pos = npos;
+            return *this;
+        }
+        iterator operator++(int)
+        {
+            iterator it = *this;
+            ++*this;
+            return it;
+        }
+
+        bool operator==(const iterator &it) const {return _pos == it._pos;}
+        bool operator!=(const iterator &it) const {return _pos != it._pos;}
+    };
+
+    iterator begin() {return iterator(this, 0);}
+    iterator end() {return iterator(this, npos);}
+
+    // tokenizer, state machine, tokenize html in place on threads of pool.
+    // html is split at '<' into chunks of at least min_chunk_size bytes,
+    // chunks are tokenized at the same time as if each starts in data
+    // state. a chunk whose start turns out to be inside a tag, comment or
+    // raw text is repaired by continuing the chunk before it, until both
+    // are in data state at the same '<'. tokens are the same as
+    // tokenize_view(). parallel mode always uses the state machine engine.
+    bool tokenize_parallel(std::string_view html, html_thread_pool &pool,
+                           size_t min_chunk_size = 64 * 1024);
+
+    // tokenizer, state machine, tokenize html in place and pass each token
+    // to handler instead of building token table. Handler has the
+    // functions of html_visitor, which are resolved at compile time.
+    template <typename Handler>
+    void tokenize(std::string_view html, Handler &handler);
+
+    // push mode, tokenize html arriving in chunks. the state machine keeps
+    // its state between chunks, a token is complete once the characters
+    // after it arrive, finish() ends the html. push mode always uses the
+    // state machine engine. return false if html exceeds 4GB.
+    bool feed(const char *html, size_t size);
+    bool finish();
+
+    // push mode, pass each complete token to handler and drop it, so only
+    // the token in progress is kept in memory. the token and its spans are
+    // valid during the call only. without handler, all tokens are kept.
+    void set_token_handler(std::function<void(const html_token &)> handler)
+    {
+        _handler = std::move(handler);
+    }
+
+    // true if compiled with -DHTML_LEXER_STATS
+#ifdef HTML_LEXER_STATS
+    static const bool stats_enabled = true;
+#else
+    static const bool stats_enabled = false;
+#endif
+
+    // get hot path statistics of the last html
+    stats_type get_stats() const;
+
+    // get name of a state
+    static const char *get_state_name(state_type state);
+
+    // print hot path statistics of the last html
+    void print_stats() const;
+
+    // get/set tokenizer engine, both engines produce the same tokens
+    engine_type get_engine() const {return _engine;}
+    void set_engine(engine_type engine) {_engine = engine;}
+
     // return the number of tokens
-    size_t size() {return _tokens.size();}
+    size_t size() const {return _store.size();}
+
+    // return the number of heap allocations for tokens
+    size_t get_allocation_count() const {return _store.get_allocation_count();}
+
+    // return the bytes reserved for tokens
+    size_t get_allocated_bytes() const {return _store.get_allocated_bytes();}
+
+    // get token table
+    const html_token_store &get_store() const {return _store;}
 
     // get nth token, return nullptr if out of range
-    html_token *get_token(size_t pos);
+    html_token get_token(size_t pos) const;
 
     // find tag by name, return npos if not found
-    size_t find_tag_by_name(const std::string &tag_name,
+    size_t find_tag_by_name(std::string_view tag_name,
                             bool start_tag,
-                            size_t pos);
+                            size_t pos) const;
+
+    // get positions of all start/end tags of a name
+    html_token_store::position_range find_all_tags_by_name(
+        std::string_view tag_name, bool start_tag) const;
 
     // find tag by name and classes, return npos if not found
-    size_t find_tag_by_class_names(const std::string &tag_name,
-                                   const std::string &classes,
-                                   size_t pos);
+    size_t find_tag_by_class_names(std::string_view tag_name,
+                                   std::string_view classes,
+                                   size_t pos) const;
 
     // find matching tag of nth tag
     // return pos, if nth tag is self-closing tag or no match tag
     // return position before pos, if nth tag is close tag
     // return position after pos, if nth tag is start tag
-    size_t find_matching_tag(size_t pos);
+    size_t find_matching_tag(size_t pos) const;
 
-    // print tokenized information
-    void print()
+    // find elements matching a css selector, return token ranges [first,
+    // last) of start tag to matching end tag in document order. compile an
+    // html_selector once to run a selector on many htmls
+    std::vector<html_selector::range_type> select(
+        std::string_view selector) const
     {
-        for (auto token : _tokens)
-        {
-            token->print();
-        }
-        std::cout.flush();
+        return html_selector(selector).match(_store);
+    }
+    std::vector<html_selector::range_type> select(
+        const html_selector &selector) const
+    {
+        return selector.match(_store);
     }
 
+    // print tokenized information to standard output, by a buffered writer
+    void print() const;
+
     // print original html of nth element
-    void print(size_t pos)
+    void print(size_t pos) const
     {
-        if (pos < _tokens.size())
+        if (pos < _store.size())
         {
-            _tokens[pos]->print(_html);
+            _store.get_token(pos).print(_html);
         }
         std::cout.flush();
     }
 };
 
+// dfa tables and template methods of html_lexer
+#include "html_dfa.hpp"
+#include "html_state_machine.hpp"
+
 #endif // __HTML_LEXER__
@@ -0,0 +1,99 @@
+//
+// HTML Lexer - Lexer Pool
+// Warm lexers kept per thread for servers
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_LEXER_POOL__
+#define __HTML_LEXER_POOL__
+
+#include <memory>
+#include <vector>
+#include "html_lexer.hpp"
+
+//
+// html_lexer_pool - idle lexers of the calling thread.
+//
+// - acquire() leases an idle lexer of the calling thread, or a new one if
+//   none is idle. The lease returns it to the pool of the thread which
+//   drops the lease.
+// - A lexer keeps its tables between htmls, so a warm lexer allocates only
+//   for a html larger than all before.
+// - At most max_idle lexers are kept per thread, others are deleted.
+//
+class html_lexer_pool
+{
+public:
+    static const size_t max_idle = 4;
+
+    // a leased lexer, move-only
+    class lease
+    {
+    private:
+        std::unique_ptr<html_lexer> _lexer;
+
+    public:
+        explicit lease(std::unique_ptr<html_lexer> lexer) :
+            _lexer(std::move(lexer)) {}
+        lease(lease &&) = default;
+        lease &operator=(lease &&other)
+        {
+            if (this != &other)
+            {
+                html_lexer_pool::release(std::move(_lexer));
+                _lexer = std::move(other._lexer);
+            }
+            return *this;
+        }
+        ~lease() {html_lexer_pool::release(std::move(_lexer));}
+
+        html_lexer &operator*() const {return *_lexer;}
+        html_lexer *operator->() const {return _lexer.get();}
+        html_lexer *get() const {return _lexer.get();}
+    };
+
+private:
+    typedef std::vector<std::unique_ptr<html_lexer>> idle_type;
+
+    // idle lexers of the calling thread
+    static idle_type &get_idle()
+    {
+        static thread_local idle_type idle;
+        return idle;
+    }
+
+    // return a lexer to the pool of the calling thread
+    static void release(std::unique_ptr<html_lexer> lexer)
+    {
+        if (!lexer) return;
+
+        idle_type &idle = get_idle();
+        if (idle.size() < max_idle)
+        {
+            idle.push_back(std::move(lexer));
+        }
+    }
+
+public:
+    // lease a lexer of the calling thread
+    static lease acquire()
+    {
+        idle_type &idle = get_idle();
+        if (idle.empty())
+        {
+            return lease(std::unique_ptr<html_lexer>(new html_lexer));
+        }
+
+        lease leased(std::move(idle.back()));
+        idle.pop_back();
+        return leased;
+    }
+
+    // return the number of idle lexers of the calling thread
+    static size_t idle_count() {return get_idle().size();}
+
+    // delete idle lexers of the calling thread and their memory
+    static void clear() {get_idle().clear();}
+};
+
+#endif // __HTML_LEXER_POOL__
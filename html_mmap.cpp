@@ -0,0 +1,164 @@
+#include <cstring> // memcpy()
+#include "html_mmap.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HTML_MMAP_POSIX
+#include <cerrno>     // errno
+#include <fcntl.h>    // open()
+#include <sys/mman.h> // mmap(), munmap(), madvise()
+#include <sys/stat.h> // fstat()
+#include <unistd.h>   // read(), close()
+#else
+#include <fstream>
+#endif
+
+// size of a huge page of x86-64 and arm64
+static const size_t huge_page_size = 2 * 1024 * 1024;
+
+// buffer of a file read instead of mapped, when its size is not known
+static const size_t read_buffer_size = 64 * 1024;
+
+// read a file to the end into buffer, which grows as needed. read(data,
+// size) returns bytes read, 0 at the end of the file or -1 on errors.
+template <typename Read>
+static bool read_all(Read read, size_t capacity,
+                     std::unique_ptr<unsigned long long[]> &buffer,
+                     size_t &size)
+{
+    // in words, a word more so a file of capacity ends in one read
+    capacity = capacity / 8 + 1;
+    buffer.reset(new unsigned long long[capacity]);
+    size = 0;
+
+    for (;;)
+    {
+        if (size == capacity * 8)
+        {
+            std::unique_ptr<unsigned long long[]> larger(
+                new unsigned long long[capacity * 2]);
+            memcpy(larger.get(), buffer.get(), size);
+            buffer = std::move(larger);
+            capacity *= 2;
+        }
+
+        long bytes = read((char *)buffer.get() + size, capacity * 8 - size);
+        if (bytes == 0) return true;
+        if (bytes < 0) return false;
+        size += bytes;
+    }
+}
+
+// map a file, return false if it cannot be opened or read
+bool html_mapped_file::open(const std::string &path, advice_type advice)
+{
+    close();
+
+#ifdef HTML_MMAP_POSIX
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    // pipes, fifos and files of /proc have no size to map, they are read
+    // as are files mmap() fails on
+    if (S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        // the mapping keeps the file open
+        void *data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd,
+                          0);
+        if (data != MAP_FAILED)
+        {
+            _data = (const char *)data;
+            _size = info.st_size;
+            advise(advice);
+        }
+    }
+
+    if (_data == nullptr)
+    {
+        auto read_fd = [fd](char *data, size_t size) -> long
+        {
+            ssize_t bytes;
+            do
+            {
+                bytes = ::read(fd, data, size);
+            } while (bytes < 0 && errno == EINTR);
+            return bytes;
+        };
+
+        size_t capacity = S_ISREG(info.st_mode) && info.st_size > 0 ?
+                          info.st_size : read_buffer_size;
+        if (read_all(read_fd, capacity, _buffer, _size))
+        {
+            _data = (const char *)_buffer.get();
+        }
+    }
+
+    ::close(fd);
+#else
+    (void)advice;
+
+    std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file) return false;
+
+    auto read_stream = [&file](char *data, size_t size) -> long
+    {
+        file.read(data, size);
+        return file.bad() ? -1 : (long)file.gcount();
+    };
+
+    if (read_all(read_stream, read_buffer_size, _buffer, _size))
+    {
+        _data = (const char *)_buffer.get();
+    }
+#endif
+
+    if (_data == nullptr)
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// change access pattern of the mapping, errors are ignored as all hints
+void html_mapped_file::advise(advice_type advice)
+{
+#ifdef HTML_MMAP_POSIX
+    if (_data == nullptr || _buffer) return;
+
+    static const int advices[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM};
+    madvise((void *)_data, _size, advices[advice]);
+
+#ifdef MADV_HUGEPAGE
+    // fewer TLB misses while scanning, if the kernel maps files by huge pages
+    if (_size >= huge_page_size)
+    {
+        madvise((void *)_data, _size, MADV_HUGEPAGE);
+    }
+#endif
+#else
+    (void)advice;
+#endif
+}
+
+// unmap the file
+void html_mapped_file::close()
+{
+#ifdef HTML_MMAP_POSIX
+    if (_data != nullptr && !_buffer)
+    {
+        munmap((void *)_data, _size);
+    }
+#endif
+
+    _buffer.reset();
+    _data = nullptr;
+    _size = 0;
+}
@@ -0,0 +1,71 @@
+//
+// HTML Lexer - Mapped File
+// Read-only memory mapping of a whole file
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_MMAP__
+#define __HTML_MMAP__
+
+#include <cstddef> // size_t
+#include <memory>  // unique_ptr
+#include <string>
+#include <string_view>
+
+//
+// html_mapped_file - a whole file mapped read-only.
+//
+// - On POSIX systems a regular file is mapped by mmap(), pages are read on
+//   first access and shared with the page cache. Pipes, fifos, files of
+//   /proc which report no size, and files mmap() fails on are read to the
+//   end into a buffer aligned to 8 bytes, as are all files elsewhere.
+// - The access pattern is passed to the kernel by madvise(), and mappings
+//   of 2MB or more ask for huge pages where supported. Both are hints,
+//   systems without them ignore them.
+// - data() stays valid until close(), open() of another file or the
+//   destructor.
+//
+class html_mapped_file
+{
+public:
+    // access pattern of the mapping
+    enum advice_type
+    {
+        advice_normal,
+        advice_sequential, // read once from start to end, e.g. tokenizing
+        advice_random      // random reads, e.g. queries of a token cache
+    };
+
+private:
+    const char *_data;
+    size_t      _size;
+
+    // not mapped, the file is read into buffer
+    std::unique_ptr<unsigned long long[]> _buffer;
+
+public:
+    html_mapped_file() : _data(nullptr), _size(0) {}
+    ~html_mapped_file() {close();}
+
+    // non-copyable, owns the mapping
+    html_mapped_file(const html_mapped_file &) = delete;
+    html_mapped_file &operator=(const html_mapped_file &) = delete;
+
+    // map a file, return false if it cannot be opened or read
+    bool open(const std::string &path, advice_type advice = advice_normal);
+
+    // change access pattern of the mapping
+    void advise(advice_type advice);
+
+    // unmap the file
+    void close();
+
+    bool is_open() const {return _data != nullptr;}
+
+    // get content of the file
+    const char *data() const {return _data;}
+    size_t size() const {return _size;}
+    std::string_view view() const {return std::string_view(_data, _size);}
+};
+
+#endif // __HTML_MMAP__
@@ -0,0 +1,298 @@
+#include <cstring> // memchr(), memcpy()
+#include "html_scan.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HTML_SCAN_X86
+#include <immintrin.h>
+#endif
+
+// scalar fallback
+static size_t find_scalar(const char *p, size_t size, char c)
+{
+    auto found = (const char *)std::memchr(p, c, size);
+    return found == nullptr ? size : found - p;
+}
+
+#ifdef HTML_SCAN_X86
+
+// SSE2, 16 bytes per step
+__attribute__((target("sse2")))
+static size_t find_sse2(const char *p, size_t size, char c)
+{
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t i = 0;
+
+    for (; i + 16 <= size; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(p + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + find_scalar(p + i, size - i, c);
+}
+
+// AVX2, 64 bytes per step, then 32 bytes
+__attribute__((target("avx2")))
+static size_t find_avx2(const char *p, size_t size, char c)
+{
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t i = 0;
+
+    for (; i + 64 <= size; i += 64)
+    {
+        __m256i lo = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i hi = _mm256_loadu_si256((const __m256i *)(p + i + 32));
+        unsigned mask_lo =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle));
+        unsigned mask_hi =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle));
+        if ((mask_lo | mask_hi) != 0)
+        {
+            return mask_lo != 0 ? i + __builtin_ctz(mask_lo) :
+                                  i + 32 + __builtin_ctz(mask_hi);
+        }
+    }
+
+    for (; i + 32 <= size; i += 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(p + i));
+        unsigned mask =
+            _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+
+    return i + find_scalar(p + i, size - i, c);
+}
+
+#endif // HTML_SCAN_X86
+
+// scalar fallback, build bitmaps of 64 bytes
+static void index_scalar(const char *p, html_structural_block *block)
+{
+    *block = html_structural_block();
+
+    for (unsigned i = 0; i < 64; ++i)
+    {
+        uint64_t bit = 1ULL << i;
+        switch (p[i])
+        {
+        case '<':
+            block->lt |= bit;
+            break;
+        case '>':
+            block->gt |= bit;
+            block->delimiter |= bit;
+            break;
+        case '"':
+            block->dquote |= bit;
+            break;
+        case '\'':
+            block->squote |= bit;
+            break;
+        case ' ':
+        case '\n':
+        case '\r':
+        case '\t':
+        case '/':
+        case '=':
+            block->delimiter |= bit;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+#ifdef HTML_SCAN_X86
+
+// SSE2, bitmaps of 16 bytes
+__attribute__((target("sse2")))
+static void index_sse2_16(const char *p, html_structural_block *block,
+                          unsigned shift)
+{
+    __m128i b = _mm_loadu_si128((const __m128i *)p);
+
+#define HTML_SCAN_EQ(c) _mm_cmpeq_epi8(b, _mm_set1_epi8(c))
+#define HTML_SCAN_MASK(v) ((uint64_t)(unsigned)_mm_movemask_epi8(v) << shift)
+
+    __m128i gt = HTML_SCAN_EQ('>');
+    __m128i delimiter =
+        _mm_or_si128(_mm_or_si128(_mm_or_si128(HTML_SCAN_EQ(' '),
+                                               HTML_SCAN_EQ('\n')),
+                                  _mm_or_si128(HTML_SCAN_EQ('\r'),
+                                               HTML_SCAN_EQ('\t'))),
+                     _mm_or_si128(_mm_or_si128(HTML_SCAN_EQ('/'),
+                                               HTML_SCAN_EQ('=')), gt));
+
+    block->lt        |= HTML_SCAN_MASK(HTML_SCAN_EQ('<'));
+    block->gt        |= HTML_SCAN_MASK(gt);
+    block->dquote    |= HTML_SCAN_MASK(HTML_SCAN_EQ('"'));
+    block->squote    |= HTML_SCAN_MASK(HTML_SCAN_EQ('\''));
+    block->delimiter |= HTML_SCAN_MASK(delimiter);
+
+#undef HTML_SCAN_MASK
+#undef HTML_SCAN_EQ
+}
+
+// SSE2, build bitmaps of 64 bytes
+__attribute__((target("sse2")))
+static void index_sse2(const char *p, html_structural_block *block)
+{
+    *block = html_structural_block();
+
+    index_sse2_16(p,      block,  0);
+    index_sse2_16(p + 16, block, 16);
+    index_sse2_16(p + 32, block, 32);
+    index_sse2_16(p + 48, block, 48);
+}
+
+// AVX2, bitmaps of 32 bytes
+__attribute__((target("avx2")))
+static void index_avx2_32(const char *p, html_structural_block *block,
+                          unsigned shift)
+{
+    __m256i b = _mm256_loadu_si256((const __m256i *)p);
+
+#define HTML_SCAN_EQ(c) _mm256_cmpeq_epi8(b, _mm256_set1_epi8(c))
+#define HTML_SCAN_MASK(v) \
+    ((uint64_t)(unsigned)_mm256_movemask_epi8(v) << shift)
+
+    __m256i gt = HTML_SCAN_EQ('>');
+    __m256i delimiter =
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(HTML_SCAN_EQ(' '),
+                                            HTML_SCAN_EQ('\n')),
+                            _mm256_or_si256(HTML_SCAN_EQ('\r'),
+                                            HTML_SCAN_EQ('\t'))),
+            _mm256_or_si256(_mm256_or_si256(HTML_SCAN_EQ('/'),
+                                            HTML_SCAN_EQ('=')), gt));
+
+    block->lt        |= HTML_SCAN_MASK(HTML_SCAN_EQ('<'));
+    block->gt        |= HTML_SCAN_MASK(gt);
+    block->dquote    |= HTML_SCAN_MASK(HTML_SCAN_EQ('"'));
+    block->squote    |= HTML_SCAN_MASK(HTML_SCAN_EQ('\''));
+    block->delimiter |= HTML_SCAN_MASK(delimiter);
+
+#undef HTML_SCAN_MASK
+#undef HTML_SCAN_EQ
+}
+
+// AVX2, build bitmaps of 64 bytes
+__attribute__((target("avx2")))
+static void index_avx2(const char *p, html_structural_block *block)
+{
+    *block = html_structural_block();
+
+    index_avx2_32(p,      block,  0);
+    index_avx2_32(p + 32, block, 32);
+}
+
+#endif // HTML_SCAN_X86
+
+// get the best kernel supported by cpu
+html_scanner::kernel_type html_scanner::get_best_kernel()
+{
+#ifdef HTML_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return kernel_avx2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return kernel_sse2;
+    }
+#endif
+
+    return kernel_scalar;
+}
+
+// set the kernel in use
+void html_scanner::set_kernel(kernel_type kernel)
+{
+    // do not use a kernel which cpu does not support
+    if (kernel > get_best_kernel())
+    {
+        kernel = kernel_scalar;
+    }
+
+    switch (kernel)
+    {
+#ifdef HTML_SCAN_X86
+    case kernel_avx2:
+        _find  = find_avx2;
+        _index = index_avx2;
+        break;
+    case kernel_sse2:
+        _find  = find_sse2;
+        _index = index_sse2;
+        break;
+#endif
+    default:
+        kernel = kernel_scalar;
+        _find  = find_scalar;
+        _index = index_scalar;
+        break;
+    }
+
+    _kernel = kernel;
+}
+
+// get the name of kernel
+const char *html_scanner::get_kernel_name(kernel_type kernel)
+{
+    switch (kernel)
+    {
+    case kernel_avx2:
+        return "avx2";
+    case kernel_sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+// choose kernel before main()
+static html_scanner::kernel_type init_kernel()
+{
+    html_scanner::kernel_type kernel = html_scanner::get_best_kernel();
+    html_scanner::set_kernel(kernel);
+
+    return kernel;
+}
+
+html_scanner::find_function  html_scanner::_find   = find_scalar;
+html_scanner::index_function html_scanner::_index  = index_scalar;
+html_scanner::kernel_type    html_scanner::_kernel = init_kernel();
+
+//
+// class html_structural_index methods
+//
+
+// build bitmaps of html, memory is kept for next html
+void html_structural_index::build(std::string_view html)
+{
+    _size = html.size();
+    _blocks.resize((_size + 63) / 64);
+
+    size_t full = _size / 64;
+    for (size_t i = 0; i < full; ++i)
+    {
+        html_scanner::index(html.data() + i * 64, &_blocks[i]);
+    }
+
+    // the last partial block is padded with '\0', which is not structural
+    if (full < _blocks.size())
+    {
+        char tail[64] = {0};
+        std::memcpy(tail, html.data() + full * 64, _size - full * 64);
+        html_scanner::index(tail, &_blocks[full]);
+    }
+}
@@ -0,0 +1,147 @@
+//
+// HTML Lexer - Scanner
+// SIMD kernels to skip runs of characters, chosen at runtime
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_SCAN__
+#define __HTML_SCAN__
+
+#include <cstddef> // size_t
+#include <cstdint> // uint64_t
+#include <string_view>
+#include <vector>
+
+// bitmaps of structural characters of 64 bytes of html, a bit per byte
+struct html_structural_block
+{
+    uint64_t lt;        // '<'
+    uint64_t gt;        // '>'
+    uint64_t dquote;    // '"'
+    uint64_t squote;    // '\''
+    uint64_t delimiter; // ' ', '\n', '\r', '\t', '/', '=', '>'
+};
+
+//
+// html_scanner - find the next occurrence of a character.
+//
+// The kernel is chosen by cpu features during static initialization, before
+// main(), AVX2, SSE2, or the scalar fallback on other cpus. Scans from
+// static initializers of other files may run the scalar kernel. set_kernel()
+// forces a kernel, e.g. for benchmarking, a kernel not supported by cpu
+// falls back to scalar.
+//
+class html_scanner
+{
+public:
+    enum kernel_type
+    {
+        kernel_scalar,
+        kernel_sse2,
+        kernel_avx2
+    };
+
+private:
+    typedef size_t (*find_function)(const char *, size_t, char);
+    typedef void (*index_function)(const char *, html_structural_block *);
+
+    // the kernel in use
+    static find_function  _find;
+    static index_function _index;
+    static kernel_type    _kernel;
+
+public:
+    // find c in [p, p + size), return size if not found
+    static size_t find(const char *p, size_t size, char c)
+    {
+        return _find(p, size, c);
+    }
+
+    // build bitmaps of 64 bytes at p
+    static void index(const char *p, html_structural_block *block)
+    {
+        _index(p, block);
+    }
+
+    // get the best kernel supported by cpu
+    static kernel_type get_best_kernel();
+
+    // get/set the kernel in use
+    static kernel_type get_kernel() {return _kernel;}
+    static void set_kernel(kernel_type kernel);
+
+    // get the name of kernel
+    static const char *get_kernel_name(kernel_type kernel);
+};
+
+//
+// html_structural_index - stage 1 of the structural engine.
+//
+// Bitmaps of structural characters are built 64 bytes at a time, the
+// tokenizer (stage 2) then jumps between structural positions instead of
+// visiting every byte.
+//
+class html_structural_index
+{
+private:
+    std::vector<html_structural_block> _blocks;
+    size_t                             _size;
+
+    // find next set bit of a bitmap from pos, return size of html if none
+    size_t find(size_t pos, uint64_t html_structural_block::*bitmap) const
+    {
+        size_t idx = pos >> 6;
+        if (idx >= _blocks.size()) return _size;
+
+        uint64_t bits = _blocks[idx].*bitmap & (~0ULL << (pos & 63));
+        while (bits == 0)
+        {
+            if (++idx == _blocks.size()) return _size;
+            bits = _blocks[idx].*bitmap;
+        }
+
+        return (idx << 6) + count_trailing_zeros(bits);
+    }
+
+    static size_t count_trailing_zeros(uint64_t bits)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(bits);
+#else
+        size_t n = 0;
+        while ((bits & 1) == 0)
+        {
+            bits >>= 1;
+            ++n;
+        }
+        return n;
+#endif
+    }
+
+public:
+    html_structural_index() : _size(0) {}
+
+    // build bitmaps of html, memory is kept for next html
+    void build(std::string_view html);
+
+    // find next structural character from pos, return size of html if none
+    size_t find_lt(size_t pos) const
+    {
+        return find(pos, &html_structural_block::lt);
+    }
+    size_t find_gt(size_t pos) const
+    {
+        return find(pos, &html_structural_block::gt);
+    }
+    size_t find_quote(size_t pos, char quote) const
+    {
+        return find(pos, quote == '"' ? &html_structural_block::dquote :
+                                        &html_structural_block::squote);
+    }
+    size_t find_delimiter(size_t pos) const
+    {
+        return find(pos, &html_structural_block::delimiter);
+    }
+};
+
+#endif // __HTML_SCAN__
@@ -0,0 +1,540 @@
+#include <algorithm> // binary_search()
+#include <cctype>    // isalnum(), tolower()
+#include "html_lexer.hpp"
+#include "html_selector.hpp"
+
+// index of the lowest set bit
+static size_t lowest_bit(uint64_t bits)
+{
+#if defined(__GNUC__)
+    return __builtin_ctzll(bits);
+#else
+    size_t n = 0;
+    while ((bits & 1) == 0)
+    {
+        bits >>= 1;
+        ++n;
+    }
+    return n;
+#endif
+}
+
+// skip spaces, return true if any
+static bool skip_spaces(std::string_view selector, size_t &pos)
+{
+    size_t start = pos;
+    while (pos < selector.size() &&
+           (selector[pos] == ' '  || selector[pos] == '\t' ||
+            selector[pos] == '\n' || selector[pos] == '\r'))
+    {
+        ++pos;
+    }
+
+    return pos != start;
+}
+
+// get an identifier at pos, return empty if none
+static std::string_view parse_identifier(std::string_view selector,
+                                         size_t &pos)
+{
+    size_t start = pos;
+    while (pos < selector.size())
+    {
+        unsigned char c = selector[pos];
+        if (!isalnum(c) && c != '-' && c != '_' && c < 0x80) break;
+        ++pos;
+    }
+
+    return selector.substr(start, pos - start);
+}
+
+// get a lower case copy
+static std::string to_lower(std::string_view name)
+{
+    std::string lower(name);
+    for (auto &c : lower)
+    {
+        c = tolower((unsigned char)c);
+    }
+
+    return lower;
+}
+
+// parse an optionally signed integer, the whole string
+static bool parse_integer(std::string_view text, long &value)
+{
+    size_t pos = 0;
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '+' || text[pos] == '-'))
+    {
+        negative = text[pos++] == '-';
+    }
+    if (pos == text.size()) return false;
+
+    value = 0;
+    for (; pos < text.size(); ++pos)
+    {
+        if (text[pos] < '0' || text[pos] > '9' || value > 1000000)
+        {
+            return false;
+        }
+        value = value * 10 + (text[pos] - '0');
+    }
+    if (negative) value = -value;
+
+    return true;
+}
+
+// parse an+b of :nth-child(), odd or even
+static bool parse_nth(std::string_view argument, long &a, long &b)
+{
+    // spaces are allowed around the signs, e.g. "2n + 1"
+    std::string text;
+    for (char c : argument)
+    {
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+        {
+            text += tolower((unsigned char)c);
+        }
+    }
+
+    if (text == "odd")
+    {
+        a = 2;
+        b = 1;
+        return true;
+    }
+    if (text == "even")
+    {
+        a = 2;
+        b = 0;
+        return true;
+    }
+
+    size_t n = text.find('n');
+    if (n == std::string::npos)
+    {
+        a = 0;
+        return parse_integer(text, b);
+    }
+
+    std::string_view coefficient = std::string_view(text).substr(0, n);
+    std::string_view offset = std::string_view(text).substr(n + 1);
+    if (coefficient.empty() || coefficient == "+")
+    {
+        a = 1;
+    }
+    else if (coefficient == "-")
+    {
+        a = -1;
+    }
+    else if (!parse_integer(coefficient, a))
+    {
+        return false;
+    }
+
+    if (offset.empty())
+    {
+        b = 0;
+        return true;
+    }
+
+    // the sign of b is required after n
+    return (offset[0] == '+' || offset[0] == '-') && parse_integer(offset, b);
+}
+
+// check if a space separated list has a word
+static bool has_word(std::string_view list, std::string_view word)
+{
+    size_t pos = 0;
+    for (auto item = html_token_store::next_class(list, pos);
+         !item.empty();
+         item = html_token_store::next_class(list, pos))
+    {
+        if (item == word) return true;
+    }
+
+    return false;
+}
+
+//
+// class html_selector methods
+//
+
+// compile a selector, return false if it is empty, malformed or not
+// supported
+bool html_selector::compile(std::string_view selector)
+{
+    _compounds.clear();
+    _valid = false;
+    _first_mask = _last_mask = _child_mask = _descendant_mask = 0;
+
+    size_t pos = 0;
+    skip_spaces(selector, pos);
+
+    // complex selectors separated by commas
+    while (true)
+    {
+        combinator_type combinator = combinator_none;
+        while (true)
+        {
+            if (_compounds.size() == max_compounds) return false;
+
+            compound_selector compound;
+            compound.combinator = combinator;
+            if (!parse_compound(selector, pos, compound)) return false;
+
+            uint64_t bit = (uint64_t)1 << _compounds.size();
+            switch (combinator)
+            {
+            case combinator_none:       _first_mask      |= bit; break;
+            case combinator_child:      _child_mask      |= bit; break;
+            case combinator_descendant: _descendant_mask |= bit; break;
+            }
+            _compounds.push_back(std::move(compound));
+
+            bool spaces = skip_spaces(selector, pos);
+            if (pos == selector.size() || selector[pos] == ',')
+            {
+                _last_mask |= bit;
+                break;
+            }
+
+            if (selector[pos] == '>')
+            {
+                ++pos;
+                skip_spaces(selector, pos);
+                combinator = combinator_child;
+            }
+            else if (spaces)
+            {
+                combinator = combinator_descendant;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        if (pos == selector.size()) break;
+
+        // a selector after the comma
+        ++pos;
+        skip_spaces(selector, pos);
+    }
+
+    _valid = true;
+    return true;
+}
+
+// parse a compound selector at pos, return false if malformed
+bool html_selector::parse_compound(std::string_view selector, size_t &pos,
+                                   compound_selector &compound)
+{
+    compound.has_nth = false;
+    compound.nth_a = 0;
+    compound.nth_b = 0;
+
+    size_t start = pos;
+    if (pos < selector.size() && selector[pos] == '*')
+    {
+        ++pos;
+    }
+    else
+    {
+        compound.name = to_lower(parse_identifier(selector, pos));
+    }
+
+    while (pos < selector.size())
+    {
+        char c = selector[pos];
+        if (c == '#' || c == '.')
+        {
+            ++pos;
+            std::string_view name = parse_identifier(selector, pos);
+            if (name.empty()) return false;
+
+            if (c == '#')
+            {
+                compound.attributes.push_back(
+                    {"id", std::string(name), operator_equals});
+            }
+            else
+            {
+                compound.classes.emplace_back(name);
+            }
+        }
+        else if (c == '[')
+        {
+            ++pos;
+            skip_spaces(selector, pos);
+
+            attribute_predicate attribute;
+            attribute.name = to_lower(parse_identifier(selector, pos));
+            attribute.op = operator_exists;
+            if (attribute.name.empty()) return false;
+
+            skip_spaces(selector, pos);
+            if (pos < selector.size() && selector[pos] != ']')
+            {
+                // =, ~=, ^=, $= or *=
+                static const std::string_view operators = "=~^$*";
+                static const operator_type types[] = {
+                    operator_equals, operator_includes, operator_prefix,
+                    operator_suffix, operator_substring
+                };
+
+                size_t op = operators.find(selector[pos]);
+                if (op == std::string_view::npos) return false;
+                if (op != 0 && (++pos == selector.size() ||
+                                selector[pos] != '='))
+                {
+                    return false;
+                }
+                attribute.op = types[op];
+                ++pos;
+                skip_spaces(selector, pos);
+
+                // quoted or an identifier
+                if (pos < selector.size() &&
+                    (selector[pos] == '"' || selector[pos] == '\''))
+                {
+                    size_t end = selector.find(selector[pos], pos + 1);
+                    if (end == std::string_view::npos) return false;
+
+                    attribute.value = selector.substr(pos + 1, end - pos - 1);
+                    pos = end + 1;
+                }
+                else
+                {
+                    attribute.value = parse_identifier(selector, pos);
+                    if (attribute.value.empty()) return false;
+                }
+                skip_spaces(selector, pos);
+            }
+
+            if (pos == selector.size() || selector[pos] != ']') return false;
+            ++pos;
+
+            compound.attributes.push_back(std::move(attribute));
+        }
+        else if (c == ':')
+        {
+            ++pos;
+            std::string pseudo = to_lower(parse_identifier(selector, pos));
+            if (compound.has_nth) return false;
+
+            if (pseudo == "first-child")
+            {
+                compound.nth_b = 1;
+            }
+            else if (pseudo == "nth-child" &&
+                     pos < selector.size() && selector[pos] == '(')
+            {
+                size_t end = selector.find(')', pos);
+                if (end == std::string_view::npos) return false;
+
+                if (!parse_nth(selector.substr(pos + 1, end - pos - 1),
+                               compound.nth_a, compound.nth_b))
+                {
+                    return false;
+                }
+                pos = end + 1;
+            }
+            else
+            {
+                return false;
+            }
+            compound.has_nth = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return pos != start;
+}
+
+// check if compound matches the start tag at pos, the nth child
+bool html_selector::match_compound(const html_token_store &store,
+                                   const compound_selector &compound,
+                                   const resolved_compound &resolved,
+                                   size_t pos, size_t child)
+{
+    if (!compound.name.empty() && store.get_name_id(pos) != resolved.name_id)
+    {
+        return false;
+    }
+
+    if (compound.has_nth)
+    {
+        // child = an + b for some n >= 0
+        long offset = (long)child - compound.nth_b;
+        if (compound.nth_a == 0 ? offset != 0 :
+            offset % compound.nth_a != 0 || offset / compound.nth_a < 0)
+        {
+            return false;
+        }
+    }
+
+    if (!resolved.class_ids.empty())
+    {
+        auto ids = store.get_class_ids(pos);
+        for (uint32_t id : resolved.class_ids)
+        {
+            if (!std::binary_search(ids.begin(), ids.end(), id)) return false;
+        }
+    }
+
+    size_t begin = store.get_attribute_begin(pos);
+    size_t end   = store.get_attribute_end(pos);
+    for (size_t i = 0; i < compound.attributes.size(); ++i)
+    {
+        // the first of duplicate attributes counts
+        uint32_t name_id = resolved.attribute_ids[i];
+        size_t idx = begin;
+        while (idx < end && store.get_attribute(idx).name_id != name_id)
+        {
+            ++idx;
+        }
+        if (idx == end) return false;
+
+        auto &entry = store.get_attribute(idx);
+        std::string_view value = store.get_span(entry.value_start,
+                                                entry.value_size);
+        std::string_view expected = compound.attributes[i].value;
+
+        bool matched = true;
+        switch (compound.attributes[i].op)
+        {
+        case operator_exists:
+            break;
+        case operator_equals:
+            matched = value == expected;
+            break;
+        case operator_includes:
+            matched = has_word(value, expected);
+            break;
+        case operator_prefix:
+            matched = !expected.empty() &&
+                      value.substr(0, expected.size()) == expected;
+            break;
+        case operator_suffix:
+            matched = !expected.empty() && value.size() >= expected.size() &&
+                      value.substr(value.size() - expected.size()) == expected;
+            break;
+        case operator_substring:
+            matched = !expected.empty() &&
+                      value.find(expected) != std::string_view::npos;
+            break;
+        }
+        if (!matched) return false;
+    }
+
+    return true;
+}
+
+// find elements of the store which match, results are appended
+void html_selector::match(const html_token_store &store,
+                          std::vector<range_type> &results) const
+{
+    if (!_valid) return;
+
+    // names and classes of the store, a compound with one missing never
+    // matches
+    uint64_t possible = 0;
+    std::vector<resolved_compound> resolved(_compounds.size());
+    for (size_t k = 0; k < _compounds.size(); ++k)
+    {
+        const compound_selector &compound = _compounds[k];
+        resolved_compound &ids = resolved[k];
+
+        bool found = true;
+        if (!compound.name.empty())
+        {
+            ids.name_id = store.find_name_id(compound.name);
+            found = ids.name_id != html_token_store::no_name;
+        }
+        for (auto &class_name : compound.classes)
+        {
+            ids.class_ids.push_back(store.find_class_id(class_name));
+            found = found && ids.class_ids.back() != html_token_store::no_name;
+        }
+        for (auto &attribute : compound.attributes)
+        {
+            ids.attribute_ids.push_back(store.find_name_id(attribute.name));
+            found = found &&
+                    ids.attribute_ids.back() != html_token_store::no_name;
+        }
+
+        if (found) possible |= (uint64_t)1 << k;
+    }
+
+    // the document is the bottom of stack, top level elements are its
+    // children
+    std::vector<open_element> stack;
+    stack.push_back({html_token_store::npos, 0, 0, 0});
+
+    for (size_t pos = 0; pos < store.size(); ++pos)
+    {
+        html_token::token_type type = store.get_type(pos);
+        if (type == html_token::token_end_tag)
+        {
+            // close the element, and elements opened in it without an end
+            // tag before this one. the end tag of a self-closing start tag
+            // closes nothing, the start tag was an empty element.
+            size_t start = store.get_matching_tag(pos);
+            if (start == pos ||
+                (store.get_flags(start) & html_token_store::flag_self_closing))
+            {
+                continue;
+            }
+
+            while (stack.size() > 1 && stack.back().pos >= start)
+            {
+                stack.pop_back();
+            }
+            continue;
+        }
+        if (type != html_token::token_start_tag) continue;
+
+        open_element &parent = stack.back();
+        size_t child = ++parent.children;
+        uint64_t ancestors = parent.ancestors;
+
+        // compounds worth testing, the first of a complex selector, or the
+        // compound before it matched the parent or an ancestor
+        uint64_t candidates = _first_mask |
+                              (_child_mask & (parent.chains << 1)) |
+                              (_descendant_mask & (ancestors << 1));
+        candidates &= possible;
+
+        uint64_t chains = 0;
+        for (uint64_t bits = candidates; bits != 0; bits &= bits - 1)
+        {
+            size_t k = lowest_bit(bits);
+            if (match_compound(store, _compounds[k], resolved[k], pos, child))
+            {
+                chains |= (uint64_t)1 << k;
+            }
+        }
+
+        // a self-closing start tag is empty, as by find_matching_tag()
+        size_t end = pos;
+        if (!(store.get_flags(pos) & html_token_store::flag_self_closing))
+        {
+            end = store.get_matching_tag(pos);
+        }
+        if (chains & _last_mask)
+        {
+            results.push_back({pos, (end > pos ? end : pos) + 1});
+        }
+
+        // a start tag without end tag has no children
+        if (end > pos)
+        {
+            stack.push_back({pos, 0, chains, ancestors | chains});
+        }
+    }
+}
@@ -0,0 +1,158 @@
+//
+// HTML Lexer - Selector
+// CSS selectors compiled once and matched in a pass over the tokens
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_SELECTOR__
+#define __HTML_SELECTOR__
+
+#include <cstddef> // size_t
+#include <cstdint> // uint32_t, uint64_t
+#include <string>
+#include <string_view>
+#include <vector>
+
+class html_token_store;
+
+//
+// html_selector - a compiled CSS selector.
+//
+// - Supported: type and universal selectors, #id, .class, [attr],
+//   [attr=value], [attr~=value], [attr^=value], [attr$=value],
+//   [attr*=value], :first-child, :nth-child(an+b|odd|even), descendant and
+//   child (>) combinators, and selector lists separated by commas, up to
+//   max_compounds compound selectors.
+// - Tag and attribute names are case insensitive, classes, ids and values
+//   are case sensitive. Values are compared with the html as it is,
+//   character references are not decoded.
+// - match() walks the tokens once with a stack of open elements. A start
+//   tag is open until its matching end tag. A start tag without one, and a
+//   self-closing one such as <div/>, are empty elements, as for
+//   find_matching_tag(), and the end tag paired with a self-closing start
+//   tag closes nothing. Browsers ignore the '/' of non-void elements, this
+//   selector does not. The compounds an element matches are bits, combined
+//   with the bits of its parent and ancestors by a few shifts, so a
+//   compound is tested only if the compounds before it matched above.
+// - A match is the token range [first, last) of the start tag to its
+//   matching end tag, in document order.
+//
+class html_selector
+{
+public:
+    // tokens [first, last) of a matched element
+    struct range_type
+    {
+        size_t first;
+        size_t last;
+    };
+
+    // compound selectors of all complex selectors, a bit each on the stack
+    static const size_t max_compounds = 64;
+
+private:
+    enum combinator_type
+    {
+        combinator_none,       // first compound of a complex selector
+        combinator_descendant, // "a b"
+        combinator_child       // "a > b"
+    };
+
+    enum operator_type
+    {
+        operator_exists,   // [attr]
+        operator_equals,   // [attr=value]
+        operator_includes, // [attr~=value], a space separated word
+        operator_prefix,   // [attr^=value]
+        operator_suffix,   // [attr$=value]
+        operator_substring // [attr*=value]
+    };
+
+    struct attribute_predicate
+    {
+        std::string   name; // lower case
+        std::string   value;
+        operator_type op;
+    };
+
+    // a compound selector, e.g. li.item[href]:nth-child(2n+1)
+    struct compound_selector
+    {
+        combinator_type combinator; // to the compound before it
+        std::string     name;       // lower case, empty for any
+        std::vector<std::string>         classes;
+        std::vector<attribute_predicate> attributes;
+
+        // :nth-child(an+b), child index i matches if i = an + b, n >= 0
+        bool has_nth;
+        long nth_a;
+        long nth_b;
+    };
+
+    // compound selectors, complex selectors are ranges of them
+    std::vector<compound_selector> _compounds;
+    bool                           _valid;
+
+    // bits of compounds, the first and the last of each complex selector,
+    // and those after a child or descendant combinator
+    uint64_t _first_mask;
+    uint64_t _last_mask;
+    uint64_t _child_mask;
+    uint64_t _descendant_mask;
+
+public:
+    html_selector() :
+        _valid(false), _first_mask(0), _last_mask(0), _child_mask(0),
+        _descendant_mask(0) {}
+    explicit html_selector(std::string_view selector) {compile(selector);}
+
+    // compile a selector, return false if it is empty, malformed or not
+    // supported, then nothing matches
+    bool compile(std::string_view selector);
+
+    bool is_valid() const {return _valid;}
+
+    // find elements of the store which match, results are appended
+    void match(const html_token_store &store,
+               std::vector<range_type> &results) const;
+
+    std::vector<range_type> match(const html_token_store &store) const
+    {
+        std::vector<range_type> results;
+        match(store, results);
+        return results;
+    }
+
+private:
+    // an open element. bit k of chains is set if compounds from the first
+    // of its complex selector to k match the element and its ancestors,
+    // with k matching the element. ancestors is chains of the element and
+    // all its ancestors.
+    struct open_element
+    {
+        size_t   pos;
+        size_t   children;
+        uint64_t chains;
+        uint64_t ancestors;
+    };
+
+    // compound selector with names and classes resolved to ids of a store
+    struct resolved_compound
+    {
+        uint32_t name_id;
+        std::vector<uint32_t> class_ids;
+        std::vector<uint32_t> attribute_ids;
+    };
+
+    // parse a compound selector at pos, return false if malformed
+    static bool parse_compound(std::string_view selector, size_t &pos,
+                               compound_selector &compound);
+
+    // check if compound matches the start tag at pos, the nth child
+    static bool match_compound(const html_token_store &store,
+                               const compound_selector &compound,
+                               const resolved_compound &resolved,
+                               size_t pos, size_t child);
+};
+
+#endif // __HTML_SELECTOR__
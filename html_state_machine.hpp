@@ -0,0 +1,703 @@
+//
+// HTML Lexer - State Machine
+// Template methods of html_lexer, tokens are passed to a handler
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_STATE_MACHINE__
+#define __HTML_STATE_MACHINE__
+
+// tokenize html in place, pass each token to handler
+template <typename Handler>
+void html_lexer::tokenize(std::string_view html, Handler &handler)
+{
+    begin_html(html);
+    run(handler);
+    end_html();
+}
+
+// pass new tag to handler
+template <typename Handler>
+void html_lexer::emit_token(Handler &handler, size_t token_end_position)
+{
+    if (_token != html_token::token_null)
+    {
+        // before emitting, push new attribute into list
+        new_attribute();
+
+        uint32_t name_id = html_atoms::find(_tag_name);
+        html_tag tag = {_base + _tag_start, _base + token_end_position,
+                        _tag_name, name_id,
+                        _attributes.data(), _attributes.size(),
+                        _self_closing};
+
+        HTML_STATS(++_stats.tokens[_token];)
+
+        if (_token == html_token::token_start_tag)
+        {
+            handler.on_start_tag(tag);
+        }
+        else
+        {
+            handler.on_end_tag(tag);
+        }
+
+        // raw text follows <textarea>, <style>, <script> and <title>
+        check_raw_text(name_id);
+
+        _token = html_token::token_null;
+        _attributes.clear();
+    }
+}
+
+// pass text to handler if pending text is not only spaces
+template <typename Handler>
+void html_lexer::emit_text(Handler &handler)
+{
+    // remove leading and trailing spaces
+    auto first = _text.find_first_not_of(" \n\r\t");
+    if (first != std::string_view::npos)
+    {
+        auto last  = _text.find_last_not_of(" \n\r\t");
+        auto start = _base + (_text.data() - _html.data());
+
+        HTML_STATS(++_stats.tokens[html_token::token_text];)
+
+        handler.on_text(html_content{html_token::token_text,
+                                     start + first, start + last + 1,
+                                     _text.substr(first, last - first + 1),
+                                     false});
+    }
+
+    _text = std::string_view();
+}
+
+// process raw text, return false if more characters are needed
+template <typename Handler>
+bool html_lexer::process_raw_text(Handler &handler)
+{
+    HTML_STATS(process_timer timer(_stats.process_ns[time_raw_text]);)
+
+    char c;
+    std::string_view name;
+    std::string_view tag_name = _raw_text_tag;
+
+    auto size  = tag_name.size();
+    auto start = _idx; // the char after '>'
+    auto pos   = start;
+
+    while (true)
+    {
+        // find position for possible end tag
+        pos = find_resumable("</", pos);
+        if (pos != std::string_view::npos)
+        {
+            // wait for the name and the char after it
+            if (pos + 2 + size >= _size && !_finished)
+            {
+                _search_pos = pos;
+                return false;
+            }
+
+            // match name
+            name = _html.substr(pos + 2, size);
+            if (html_iequals(tag_name, name) && pos + 2 + size < _size)
+            {
+                // It is the end tag if the name is followed by '>' or space
+                c = _html[pos + 2 + size];
+                if (c == '>' || c == ' ' || c == '\n' || c == '\r' || c == '\t')
+                {
+                    break;
+                }
+            }
+
+            pos += 2;
+            continue;
+        }
+        else
+        {
+            if (!_finished) return false;
+
+            // Not found, treat all other chars as raw text
+            pos = _size;
+        }
+
+        break;
+    }
+
+    if (pos != start)
+    {
+        HTML_STATS(++_stats.tokens[html_token::token_raw_text];)
+
+        // emit raw text token
+        handler.on_raw_text(html_content{html_token::token_raw_text,
+                                         _base + start, _base + pos,
+                                         _html.substr(start, pos - start),
+                                         false});
+    }
+
+    _search_pos = 0;
+    _idx = pos - 1; // point to the char before '<' or the last char of html
+    _state = state_data;
+
+    return true;
+}
+
+// process markup declaration, <!-- -->, <![CDATA[...]]>, or <!doctype>
+// return false if more characters are needed
+template <typename Handler>
+bool html_lexer::process_markup_declaration(Handler &handler)
+{
+    HTML_STATS(process_timer timer(
+        _stats.process_ns[time_markup_declaration]);)
+
+    // wait for enough chars to tell "--", "[CDATA[" and "DOCTYPE" apart
+    if (!_finished && _size - _idx < 7 && _html.compare(_idx, 2, "--") != 0)
+    {
+        return false;
+    }
+
+    if (_html.compare(_idx, 2, "--") == 0)
+    {
+        bool terminated = false;
+
+        auto pos = find_resumable("-->", _idx + 2);
+        if (pos == std::string_view::npos)
+        {
+            if (!_finished) return false;
+
+            _idx = _size - 1; // point to the last char of html
+        }
+        else
+        {
+            terminated = true;
+            _idx = pos + 2; // point to '>'
+        }
+
+        HTML_STATS(++_stats.tokens[html_token::token_comment];)
+
+        // emit comment token, content is between "<!--" and "-->"
+        auto start = _tag_start + 4;
+        auto end   = terminated ? _idx - 2 : _idx + 1;
+        handler.on_comment(html_content{html_token::token_comment,
+                                        _base + _tag_start, _base + _idx + 1,
+                                        _html.substr(start, end - start),
+                                        terminated});
+
+        _state = state_data;
+    }
+    else if (_html.substr(_idx, 7) == "[CDATA[")
+    {
+        auto pos = find_resumable("]]>", _idx + 7);
+        if (pos == std::string_view::npos)
+        {
+            if (!_finished) return false;
+
+            _idx = _size - 1; // point to the last char of html
+        }
+        else
+        {
+            _idx = pos + 2; // point to '>'
+        }
+
+        HTML_STATS(++_stats.tokens[html_token::token_raw_text];)
+
+        // emit raw text token, content is the whole <![CDATA[...]]>
+        handler.on_raw_text(html_content{html_token::token_raw_text,
+                                         _base + _tag_start, _base + _idx + 1,
+                                         _html.substr(_tag_start,
+                                                      _idx + 1 - _tag_start),
+                                         false});
+
+        _state = state_data;
+    }
+    else if (html_iequals(_html.substr(_idx, 7), "DOCTYPE"))
+    {
+        // name "!doctype" starts right after '<'
+        new_tag(html_token::token_start_tag);
+        _tag_name = _html.substr(_tag_start + 1, 8);
+        _idx += 6; // point to 'E'
+        _state = state_tag_name;
+    }
+    else
+    {
+        return process_bogus_comment(handler);
+    }
+
+    _search_pos = 0;
+    return true;
+}
+
+// process bogus comment, return false if more characters are needed
+template <typename Handler>
+bool html_lexer::process_bogus_comment(Handler &handler)
+{
+    HTML_STATS(process_timer timer(_stats.process_ns[time_bogus_comment]);)
+
+    auto pos = find_resumable(">", _idx);
+    if (pos == std::string_view::npos)
+    {
+        if (!_finished) return false;
+
+        pos = _size - 1;
+    }
+
+    HTML_STATS(++_stats.tokens[html_token::token_bogus_comment];)
+
+    // emit bogus comment token, content is the whole <!...> or <?...>
+    handler.on_comment(html_content{html_token::token_bogus_comment,
+                                    _base + _tag_start, _base + pos + 1,
+                                    _html.substr(_tag_start,
+                                                 pos + 1 - _tag_start),
+                                    false});
+
+    _search_pos = 0;
+    _idx = pos; // point to '>' or the last char of html
+    _state = state_data;
+
+    return true;
+}
+
+// run state machine until end of html, or more characters are needed
+template <typename Handler>
+void html_lexer::run(Handler &handler)
+{
+#ifdef HTML_LEXER_DFA
+    run_dfa(handler);
+#else
+    run_switch(handler);
+#endif
+}
+
+// run state machine of switch and if-chains
+template <typename Handler>
+void html_lexer::run_switch(Handler &handler)
+{
+    char c;
+
+    HTML_STATS(state_counter counter(*this);)
+
+    while (_idx < _size && !_pause)
+    {
+        HTML_STATS(counter.count();)
+
+        c = _html[_idx];
+
+        switch (_state)
+        {
+        // http://www.w3.org/TR/html5/syntax.html#data-_state
+        case state_data:
+            // std::cerr << "state_data" << std::endl;
+            if (c == '<')
+            {
+                // remember tag open position
+                _tag_start = _idx;
+                _state = state_tag_open;
+                emit_text(handler);
+
+                // parallel mode, chunk ends here
+                if (_idx >= _sync_pos) _pause = true;
+            }
+            else
+            {
+                // append text before next '<' at once
+                append_run(_text, '<');
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#tag-open-_state
+        case state_tag_open:
+            // std::cerr << "state_tag_open" << std::endl;
+            if (c == '!')
+            {
+                _state = state_markup_declaration_open;
+            }
+            else if (c == '/')
+            {
+                _state = state_end_tag_open;
+            }
+            else if (isupper(c) || islower(c))
+            {
+                new_tag(html_token::token_start_tag);
+                extend_span(_tag_name, _html.data() + _idx);
+                _state = state_tag_name;
+            }
+            else if (c == '?')
+            {
+                _state = state_bogus_comment;
+            }
+            else
+            {
+                // parse error
+                _state = state_data;
+                continue; // reconsume current char
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#end-tag-open-_state
+        case state_end_tag_open:
+            // std::cerr << "state_end_tag_open" << std::endl;
+            if (isupper(c) || islower(c))
+            {
+                new_tag(html_token::token_end_tag);
+                extend_span(_tag_name, _html.data() + _idx);
+                _state = state_tag_name;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+            }
+            else
+            {
+                // parse error
+                _state = state_bogus_comment;
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#tag-name-_state
+        case state_tag_name:
+            // std::cerr << "state_tag_name" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                _state = state_before_attribute_name;
+            }
+            else if (c == '/')
+            {
+                _state = state_self_closing_start_tag;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                append_delimited_run(_tag_name);
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#before-attribute-name-_state
+        case state_before_attribute_name:
+            // std::cerr << "state_before_attribute_name" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                // ignore
+            }
+            else if (c == '/')
+            {
+                _state = state_self_closing_start_tag;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                if (c == '"' || c == '\'' || c == '<' || c == '=')
+                {
+                    // treat it as attribute name
+                }
+
+                new_attribute();
+                extend_span(_attribute_name, _html.data() + _idx);
+                _state = state_attribute_name;
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#attribute-name-_state
+        case state_attribute_name:
+            // std::cerr << "state_attribute_name" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                _state = state_after_attribute_name;
+            }
+            else if (c == '/')
+            {
+                _state = state_self_closing_start_tag;
+            }
+            else if (c == '=')
+            {
+                _state = state_before_attribute_value;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                if (c == '"' || c == '\'' || c == '<')
+                {
+                    // treat it as attribute name
+                }
+
+                append_delimited_run(_attribute_name);
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#after-attribute-name-_state
+        case state_after_attribute_name:
+            // std::cerr << "state_after_attribute_name" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                // ignore
+            }
+            else if (c == '/')
+            {
+                _state = state_self_closing_start_tag;
+            }
+            else if (c == '=')
+            {
+                _state = state_before_attribute_value;
+            }
+            else if (c =='>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                if (c == '"' || c == '\'' || c == '<')
+                {
+                    // treat it as attribute name
+                }
+
+                new_attribute();
+                extend_span(_attribute_name, _html.data() + _idx);
+                _state = state_attribute_name;
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#before-attribute-value-_state
+        case state_before_attribute_value:
+            // std::cerr << "state_before_attribute_value" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                // ignore
+            }
+            else if (c == '"')
+            {
+                _state = state_attribute_value_double_quoted;
+            }
+            else if (c == '\'')
+            {
+                _state = state_attribute_value_single_quoted;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                if (c == '<' || c == '=' || c == '`')
+                {
+                    // but treat it as anything else
+                }
+
+                extend_span(_attribute_value, _html.data() + _idx);
+                _state = state_attribute_value_unquoted;
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(double-quoted)-_state
+        case state_attribute_value_double_quoted:
+            // std::cerr << "state_attribute_value_double_quoted" << std::endl;
+            if (c == '"')
+            {
+                _state = state_after_attribute_value_quoted;
+            }
+            else
+            {
+                // append value before closing '"' at once
+                append_run(_attribute_value, '"');
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(single-quoted)-_state
+        case state_attribute_value_single_quoted:
+            // std::cerr << "state_attribute_value_single_quoted" << std::endl;
+            if (c == '\'')
+            {
+                _state = state_after_attribute_value_quoted;
+            }
+            else
+            {
+                // append value before closing '\'' at once
+                append_run(_attribute_value, '\'');
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#attribute-value-(unquoted)-_state
+        case state_attribute_value_unquoted:
+            // std::cerr << "state_attribute_value_unquoted" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                _state = state_before_attribute_name;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                if (c == '"' || c == '\'' || c == '<' || c == '=' || c == '`')
+                {
+                    // but treat it as anything else
+                }
+
+                append_delimited_run(_attribute_value);
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#after-attribute-value-(quoted)-_state
+        case state_after_attribute_value_quoted:
+            // std::cerr << "state_after_attribute_value_quoted" << std::endl;
+            if (c == ' ' || c == '\n' || c == '\r' || c == '\t')
+            {
+                _state = state_before_attribute_name;
+            }
+            else if (c == '/')
+            {
+                _state = state_self_closing_start_tag;
+            }
+            else if (c == '>')
+            {
+                _state = state_data;
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                _state = state_before_attribute_name;
+                continue; // reconsume the character
+            }
+            break;
+
+        // http://www.w3.org/TR/html5/syntax.html#self-closing-start-tag-_state
+        case state_self_closing_start_tag:
+            // std::cerr << "state_self_closing_start_tag" << std::endl;
+            if (c == '>')
+            {
+                _state = state_data;
+                set_self_closing();
+                emit_token(handler, _idx + 1);
+            }
+            else
+            {
+                // parse error
+                _state = state_before_attribute_name;
+                continue; // reconsume the character
+            }
+            break;
+        case state_bogus_comment:
+            if (!process_bogus_comment(handler)) return;
+            break;
+        case state_markup_declaration_open:
+            if (!process_markup_declaration(handler)) return;
+            break;
+        case state_raw_text:
+            if (!process_raw_text(handler)) return;
+            break;
+        default:
+            // std::cerr << "what is this?" << std::endl;
+            break;
+        }
+
+        ++_idx; // consume next char
+    }
+}
+
+// run state machine of html_dfa tables, same tokens as run_switch()
+template <typename Handler>
+void html_lexer::run_dfa(Handler &handler)
+{
+    HTML_STATS(state_counter counter(*this);)
+
+    while (_idx < _size && !_pause)
+    {
+        HTML_STATS(counter.count();)
+
+        auto &t = html_dfa_tables::get_transition(
+            _state, html_dfa_tables::get_class(_html[_idx]));
+
+        // move first, emit_token() may move to raw text state
+        _state = (state_type)t.next;
+
+        switch (t.action)
+        {
+        case html_dfa::action_none:
+            break;
+        case html_dfa::action_reconsume:
+            continue; // reconsume current char
+        case html_dfa::action_tag_open:
+            // remember tag open position
+            _tag_start = _idx;
+            emit_text(handler);
+
+            // parallel mode, chunk ends here
+            if (_idx >= _sync_pos) _pause = true;
+            break;
+        case html_dfa::action_append_text:
+            // append text before next '<' at once
+            append_run(_text, '<');
+            break;
+        case html_dfa::action_new_start_tag:
+            new_tag(html_token::token_start_tag);
+            extend_span(_tag_name, _html.data() + _idx);
+            break;
+        case html_dfa::action_new_end_tag:
+            new_tag(html_token::token_end_tag);
+            extend_span(_tag_name, _html.data() + _idx);
+            break;
+        case html_dfa::action_append_tag_name:
+            append_delimited_run(_tag_name);
+            break;
+        case html_dfa::action_new_attribute:
+            new_attribute();
+            extend_span(_attribute_name, _html.data() + _idx);
+            break;
+        case html_dfa::action_append_attribute_name:
+            append_delimited_run(_attribute_name);
+            break;
+        case html_dfa::action_start_value:
+            extend_span(_attribute_value, _html.data() + _idx);
+            break;
+        case html_dfa::action_append_value:
+            append_delimited_run(_attribute_value);
+            break;
+        case html_dfa::action_append_value_dquote:
+            append_run(_attribute_value, '"');
+            break;
+        case html_dfa::action_append_value_squote:
+            append_run(_attribute_value, '\'');
+            break;
+        case html_dfa::action_emit_self_closing:
+            set_self_closing();
+            emit_token(handler, _idx + 1);
+            break;
+        case html_dfa::action_emit:
+            emit_token(handler, _idx + 1);
+            break;
+        case html_dfa::action_bogus_comment:
+            if (!process_bogus_comment(handler)) return;
+            break;
+        case html_dfa::action_markup_declaration:
+            if (!process_markup_declaration(handler)) return;
+            break;
+        case html_dfa::action_raw_text:
+            if (!process_raw_text(handler)) return;
+            break;
+        }
+
+        ++_idx; // consume next char
+    }
+}
+
+#endif // __HTML_STATE_MACHINE__
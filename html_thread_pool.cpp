@@ -0,0 +1,168 @@
+#include "html_thread_pool.hpp"
+
+// start threads - 1 workers
+html_thread_pool::html_thread_pool(size_t threads) :
+    _body(nullptr), _count(0), _done(0), _running(0), _generation(0),
+    _stop(false)
+{
+    if (threads == 0)
+    {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+
+    _blocks.reset(new block[threads]);
+    for (size_t i = 0; i < threads; ++i)
+    {
+        _blocks[i].begin = 0;
+        _blocks[i].end   = 0;
+    }
+
+    for (size_t i = 1; i < threads; ++i)
+    {
+        _workers.emplace_back(&html_thread_pool::work, this, i);
+    }
+}
+
+// stop and join workers
+html_thread_pool::~html_thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _start.notify_all();
+
+    for (auto &worker : _workers)
+    {
+        worker.join();
+    }
+}
+
+// worker thread, run each loop until pool stops
+void html_thread_pool::work(size_t thread)
+{
+    size_t generation = 0;
+
+    while (true)
+    {
+        const body_type *body;
+
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _start.wait(lock, [&] {return _stop || _generation != generation;});
+            if (_stop) return;
+
+            // a worker woken late skips a finished loop, its body may be
+            // gone. a running worker keeps parallel_for() from returning.
+            generation = _generation;
+            if (_done == _count) continue;
+
+            body = _body;
+            ++_running;
+        }
+
+        size_t done = run_loop(*body, thread);
+
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _done += done;
+            --_running;
+        }
+        _finish.notify_all();
+    }
+}
+
+// claim and run iterations until none left, return the number run
+size_t html_thread_pool::run_loop(const body_type &body, size_t thread)
+{
+    size_t done = 0;
+    size_t iteration;
+
+    while (claim(thread, iteration) || steal(thread, iteration))
+    {
+        body(iteration, thread);
+        ++done;
+    }
+
+    return done;
+}
+
+// claim next iteration of own block
+bool html_thread_pool::claim(size_t thread, size_t &iteration)
+{
+    block &own = _blocks[thread];
+    std::lock_guard<std::mutex> lock(own.mutex);
+
+    if (own.begin == own.end) return false;
+
+    iteration = own.begin++;
+    return true;
+}
+
+// move back half of another block to own block and claim its first
+// iteration, only one block is locked at a time
+bool html_thread_pool::steal(size_t thread, size_t &iteration)
+{
+    size_t threads = size();
+
+    for (size_t i = 1; i < threads; ++i)
+    {
+        block &victim = _blocks[(thread + i) % threads];
+        size_t begin, end;
+
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            size_t left = victim.end - victim.begin;
+            if (left == 0) continue;
+
+            end = victim.end;
+            victim.end -= (left + 1) / 2;
+            begin = victim.end;
+        }
+
+        block &own = _blocks[thread];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        iteration = begin;
+        own.begin = begin + 1;
+        own.end   = end;
+
+        return true;
+    }
+
+    return false;
+}
+
+// run body(i, thread) for i in [0, count) on all threads
+void html_thread_pool::parallel_for(size_t count, const body_type &body)
+{
+    {
+        // workers of the last loop must leave before blocks are reset
+        std::unique_lock<std::mutex> lock(_mutex);
+        _finish.wait(lock, [&] {return _running == 0;});
+
+        // an even block of iterations per thread
+        size_t threads = size();
+        for (size_t i = 0; i < threads; ++i)
+        {
+            std::lock_guard<std::mutex> block_lock(_blocks[i].mutex);
+            _blocks[i].begin = count * i / threads;
+            _blocks[i].end   = count * (i + 1) / threads;
+        }
+
+        _body  = &body;
+        _count = count;
+        _done  = 0;
+        ++_generation;
+    }
+    _start.notify_all();
+
+    size_t done = run_loop(body, 0);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done += done;
+    _finish.wait(lock, [&] {return _done == _count && _running == 0;});
+}
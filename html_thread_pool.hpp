@@ -0,0 +1,99 @@
+//
+// HTML Lexer - Thread Pool
+// Worker threads running parallel loops with work stealing
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_THREAD_POOL__
+#define __HTML_THREAD_POOL__
+
+#include <condition_variable>
+#include <cstddef> // size_t
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//
+// html_thread_pool - a fixed number of threads running parallel_for().
+//
+// - The calling thread works as thread 0, a pool of n threads starts
+//   n - 1 workers.
+// - Iterations are split into even blocks [begin, end), a block per
+//   thread with a lock of its own, no counter is shared by all threads.
+//   The owner takes the next iteration from the front of its block.
+// - A thread whose block is empty steals from the back: the back half of
+//   the next non-empty block becomes its own block. Thieves and the owner
+//   work at opposite ends, so iterations of uneven cost, e.g. documents of
+//   different sizes, are balanced between threads.
+// - Calls of parallel_for() must not overlap.
+//
+class html_thread_pool
+{
+public:
+    // body(iteration, thread), thread is in [0, size())
+    typedef std::function<void(size_t, size_t)> body_type;
+
+private:
+    // iterations [begin, end) not yet claimed by a thread
+    struct block
+    {
+        std::mutex mutex;
+        size_t     begin;
+        size_t     end;
+    };
+
+    std::vector<std::thread> _workers;
+    std::unique_ptr<block[]> _blocks; // a block per thread
+
+    std::mutex              _mutex;
+    std::condition_variable _start;  // a loop started, or pool stops
+    std::condition_variable _finish; // a worker left the loop
+
+    // the loop in progress, iterations [0, _count) of _body
+    const body_type *_body;
+    size_t           _count;
+    size_t           _done;    // iterations finished
+    size_t           _running; // workers in the loop
+    size_t           _generation;
+    bool             _stop;
+
+    // worker thread, run each loop until pool stops
+    void work(size_t thread);
+
+    // claim and run iterations until none left, return the number run
+    size_t run_loop(const body_type &body, size_t thread);
+
+    // claim next iteration of own block
+    bool claim(size_t thread, size_t &iteration);
+
+    // move back half of another block to own block and claim its first
+    // iteration, return false if all blocks are empty
+    bool steal(size_t thread, size_t &iteration);
+
+public:
+    // threads is the number of threads including the caller, 0 for the
+    // number of cpus
+    explicit html_thread_pool(size_t threads = 0);
+    ~html_thread_pool();
+
+    html_thread_pool(const html_thread_pool &) = delete;
+    html_thread_pool &operator=(const html_thread_pool &) = delete;
+
+    // return the number of threads including the caller
+    size_t size() const {return _workers.size() + 1;}
+
+    // run body(i, thread) for i in [0, count) on all threads, return after
+    // all iterations are done. thread identifies per-thread state, e.g. a
+    // lexer per thread.
+    void parallel_for(size_t count, const body_type &body);
+
+    // run body(i) for i in [0, count) on all threads
+    void parallel_for(size_t count, const std::function<void(size_t)> &body)
+    {
+        parallel_for(count, [&](size_t i, size_t) {body(i);});
+    }
+};
+
+#endif // __HTML_THREAD_POOL__
@@ -0,0 +1,376 @@
+#include <algorithm>  // lower_bound()
+#include <cstdio>     // fopen(), fwrite()
+#include <cstring>    // memcpy(), memcmp()
+#include <filesystem> // rename(), remove()
+#include "html_token_cache.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h> // fsync()
+#define html_sync_file(file) ::fsync(fileno(file))
+#else
+#include <io.h>     // _commit()
+#define html_sync_file(file) ::_commit(_fileno(file))
+#endif
+
+static const char magic[8] = {'H', 'T', 'M', 'L', 'T', 'O', 'K', '\0'};
+
+// hash of atom names in order of their ids, a cache written with another
+// atom table has other name ids even if the count is the same
+static uint64_t get_atom_hash()
+{
+    static const uint64_t hash = []
+    {
+        std::string names;
+        for (uint32_t atom = 0; atom < atom_count; ++atom)
+        {
+            names += html_atoms::get_name(atom);
+            names += '\0';
+        }
+        return html_content_hash(names);
+    }();
+
+    return hash;
+}
+
+// write an array of a section, return false if failed
+template <typename T>
+static bool write_section(FILE *file, const T *data, size_t count)
+{
+    return count == 0 || fwrite(data, sizeof(T), count, file) == count;
+}
+
+// file size of a header
+size_t html_token_cache::get_file_size(const header_type &header)
+{
+    size_t tokens = header.token_count;
+    return sizeof(header_type) +
+           sizeof(uint32_t) * (tokens * 5 + 1) +
+           sizeof(attribute_entry) * header.attribute_count +
+           sizeof(uint32_t) * (header.name_count * 3 + header.slot_count +
+                               header.tag_offset_count +
+                               header.tag_position_count) +
+           sizeof(uint8_t) * tokens * 2;
+}
+
+// write tables of a store of a whole html
+bool html_token_cache::write(const std::string &path,
+                             const html_token_store &store)
+{
+    // in push mode with a handler, tokens before base were dropped
+    if (store._base != 0) return false;
+
+    // the indexes are part of the file
+    if (store._matches.size() != store.size())
+    {
+        store.build_match_table();
+    }
+    if (store._tag_index_size != store.size())
+    {
+        store.build_tag_index();
+    }
+
+    // interned names are written as spans of their first tag or attribute
+    size_t names = store._name_table.size();
+    std::vector<uint32_t> name_spans(names * 2, 0);
+    std::vector<bool> spanned(names, false);
+
+    auto add_span = [&](uint32_t name_id, size_t start)
+    {
+        if (name_id < atom_count || name_id == html_token_store::no_name)
+        {
+            return;
+        }
+
+        size_t index = name_id - atom_count;
+        if (!spanned[index])
+        {
+            spanned[index] = true;
+            name_spans[index * 2]     = (uint32_t)start;
+            name_spans[index * 2 + 1] =
+                (uint32_t)store._name_table[index].size();
+        }
+    };
+
+    for (size_t pos = 0; pos < store.size(); ++pos)
+    {
+        // name starts after '<' or "</"
+        auto type = store.get_type(pos);
+        if (type == html_token::token_start_tag)
+        {
+            add_span(store._names[pos], store._starts[pos] + 1);
+        }
+        else if (type == html_token::token_end_tag)
+        {
+            add_span(store._names[pos], store._starts[pos] + 2);
+        }
+    }
+    for (auto &attribute : store._attributes)
+    {
+        add_span(attribute.name_id, attribute.name_start);
+    }
+
+    // names of dropped tokens have no span
+    if (std::find(spanned.begin(), spanned.end(), false) != spanned.end())
+    {
+        return false;
+    }
+
+    header_type header = {};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version            = version;
+    header.atom_count         = atom_count;
+    header.atom_hash          = get_atom_hash();
+    header.html_size          = store._html.size();
+    header.html_hash          = html_content_hash(store._html);
+    header.token_count        = (uint32_t)store.size();
+    header.attribute_count    = (uint32_t)store._attributes.size();
+    header.name_count         = (uint32_t)names;
+    header.slot_count         = names == 0 ?
+                                0 : (uint32_t)store._name_slots.size();
+    header.tag_offset_count   = (uint32_t)store._tag_offsets.size();
+    header.tag_position_count = (uint32_t)store._tag_positions.size();
+
+    // written to a temporary file which replaces path when complete, so
+    // open() never maps a part of a file
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+
+    uint32_t attribute_end = header.attribute_count;
+
+    bool written =
+        write_section(file, &header, 1) &&
+        write_section(file, store._starts.data(), store.size()) &&
+        write_section(file, store._ends.data(), store.size()) &&
+        write_section(file, store._names.data(), store.size()) &&
+        write_section(file, store._attribute_begins.data(), store.size()) &&
+        write_section(file, &attribute_end, 1) &&
+        write_section(file, store._matches.data(), store.size()) &&
+        write_section(file, store._attributes.data(),
+                      store._attributes.size()) &&
+        write_section(file, name_spans.data(), name_spans.size()) &&
+        write_section(file, store._name_hashes.data(), names) &&
+        write_section(file, store._name_slots.data(), header.slot_count) &&
+        write_section(file, store._tag_offsets.data(),
+                      store._tag_offsets.size()) &&
+        write_section(file, store._tag_positions.data(),
+                      store._tag_positions.size()) &&
+        write_section(file, store._types.data(), store.size()) &&
+        write_section(file, store._flags.data(), store.size()) &&
+        fflush(file) == 0 && html_sync_file(file) == 0;
+    written = fclose(file) == 0 && written;
+
+    std::error_code error;
+    if (written)
+    {
+        std::filesystem::rename(temporary, path, error);
+    }
+    if (!written || error)
+    {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+
+    return true;
+}
+
+// map a cache file of html, return false if it cannot be read or does not
+// match html
+bool html_token_cache::open(const std::string &path, std::string_view html)
+{
+    close();
+
+    if (!_file.open(path, html_mapped_file::advice_random)) return false;
+
+    // check header against the html before trusting the sections, the name
+    // table must have free slots to end probing
+    auto header = (const header_type *)_file.data();
+    if (_file.size() < sizeof(header_type) ||
+        std::memcmp(header->magic, magic, sizeof(magic)) != 0 ||
+        header->version != version ||
+        header->atom_count != atom_count ||
+        header->atom_hash != get_atom_hash() ||
+        header->html_size != html.size() ||
+        (header->slot_count & (header->slot_count - 1)) != 0 ||
+        (uint64_t)header->name_count * 2 > header->slot_count ||
+        _file.size() != get_file_size(*header) ||
+        header->html_hash != html_content_hash(html))
+    {
+        close();
+        return false;
+    }
+
+    _html   = html;
+    _header = header;
+
+    // sections follow the header in order
+    auto section = (const uint32_t *)(header + 1);
+    auto next = [&section](size_t count)
+    {
+        auto begin = section;
+        section += count;
+        return begin;
+    };
+
+    size_t tokens = header->token_count;
+    _starts           = next(tokens);
+    _ends             = next(tokens);
+    _names            = next(tokens);
+    _attribute_begins = next(tokens + 1);
+    _matches          = next(tokens);
+    _attributes       = (const attribute_entry *)next(
+        header->attribute_count * sizeof(attribute_entry) / sizeof(uint32_t));
+    _name_spans       = next(header->name_count * 2);
+    _name_hashes      = next(header->name_count);
+    _name_slots       = next(header->slot_count);
+    _tag_offsets      = next(header->tag_offset_count);
+    _tag_positions    = next(header->tag_position_count);
+    _types            = (const uint8_t *)section;
+    _flags            = _types + tokens;
+
+    // a corrupt file is rejected here instead of read out of bounds later
+    if (!check_sections())
+    {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+// check that positions of sections are in the html and indexes are in their
+// sections
+bool html_token_cache::check_sections() const
+{
+    uint64_t html_size = _header->html_size;
+    size_t tokens = _header->token_count;
+    size_t names  = atom_count + (size_t)_header->name_count;
+
+    // a span [start, start + size) of the html
+    auto in_html = [html_size](uint64_t start, uint64_t size)
+    {
+        return start <= html_size && size <= html_size - start;
+    };
+
+    for (size_t pos = 0; pos < tokens; ++pos)
+    {
+        if (_starts[pos] > _ends[pos] || _ends[pos] > html_size ||
+            (_names[pos] >= names &&
+             _names[pos] != html_token_store::no_name) ||
+            _matches[pos] >= tokens ||
+            _types[pos] > html_token::token_raw_text)
+        {
+            return false;
+        }
+    }
+
+    // attribute ranges follow each other to the end of the table
+    if (_attribute_begins[0] != 0 ||
+        _attribute_begins[tokens] != _header->attribute_count)
+    {
+        return false;
+    }
+    for (size_t pos = 0; pos < tokens; ++pos)
+    {
+        if (_attribute_begins[pos] > _attribute_begins[pos + 1]) return false;
+    }
+
+    for (size_t i = 0; i < _header->attribute_count; ++i)
+    {
+        auto &attribute = _attributes[i];
+        if (attribute.name_id >= names ||
+            !in_html(attribute.name_start, attribute.name_size) ||
+            !in_html(attribute.value_start, attribute.value_size))
+        {
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < _header->name_count; ++i)
+    {
+        if (!in_html(_name_spans[i * 2], _name_spans[i * 2 + 1]))
+        {
+            return false;
+        }
+    }
+
+    // a slot is 0 if free, or index + 1 of a name
+    for (size_t slot = 0; slot < _header->slot_count; ++slot)
+    {
+        if (_name_slots[slot] > _header->name_count) return false;
+    }
+
+    // position ranges of the tag index follow each other
+    for (size_t i = 0; i < _header->tag_offset_count; ++i)
+    {
+        if (_tag_offsets[i] > _header->tag_position_count ||
+            (i > 0 && _tag_offsets[i - 1] > _tag_offsets[i]))
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < _header->tag_position_count; ++i)
+    {
+        if (_tag_positions[i] >= tokens) return false;
+    }
+
+    return true;
+}
+
+// unmap the file
+void html_token_cache::close()
+{
+    _file.close();
+    _html   = std::string_view();
+    _header = nullptr;
+}
+
+// get name id of name, return no_name if it is neither known nor in html
+uint32_t html_token_cache::find_name_id(std::string_view name) const
+{
+    uint32_t atom = html_atoms::find(name);
+    if (atom != html_atoms::none) return atom;
+
+    if (_header->slot_count == 0) return html_token_store::no_name;
+
+    // probe the open addressing table of html_token_store
+    uint32_t hash = html_atom_hash::hash(name);
+    size_t   mask = _header->slot_count - 1;
+    for (size_t slot = hash & mask; ; slot = (slot + 1) & mask)
+    {
+        uint32_t index = _name_slots[slot];
+        if (index == 0) return html_token_store::no_name;
+
+        if (_name_hashes[index - 1] == hash &&
+            html_iequals(get_name(atom_count + index - 1), name))
+        {
+            return atom_count + index - 1;
+        }
+    }
+}
+
+// find tag by name, return npos if not found
+size_t html_token_cache::find_tag_by_name(
+    std::string_view tag_name, bool start_tag, size_t pos) const
+{
+    auto positions = find_all_tags_by_name(tag_name, start_tag);
+
+    // the first position not before pos
+    auto it = std::lower_bound(positions.begin(), positions.end(), pos);
+    return it == positions.end() ? npos : *it;
+}
+
+// find matching tag of nth tag
+size_t html_token_cache::find_matching_tag(size_t pos) const
+{
+    if (pos >= size()) return npos;
+
+    if (get_type(pos) == html_token::token_start_tag &&
+        (get_flags(pos) & html_token_store::flag_self_closing))
+    {
+        return pos;
+    }
+
+    // lookup match table
+    return _matches[pos];
+}
@@ -0,0 +1,203 @@
+//
+// HTML Lexer - Token Cache
+// Binary token tables of a html, written next to it and mapped back
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_TOKEN_CACHE__
+#define __HTML_TOKEN_CACHE__
+
+#include "html_lexer.hpp"
+#include "html_mmap.hpp"
+
+//
+// html_token_cache - token tables of a html in a file, queried in place.
+//
+// - write() saves the token table, attribute table, name table, match
+//   table and tag index of a html_token_store. All strings are positions
+//   of the original html, so the file holds no text of it.
+// - open() maps the file, checks its header against the html and the
+//   sections against their bounds, then the queries read the mapped tables
+//   directly, nothing is parsed or copied.
+// - The file is in native byte order, and is valid only for the same
+//   version, atoms and html. Atoms are checked by a hash of their names in
+//   order, as name ids are indexes of the atom table. A mismatch fails
+//   open(), tokenize the html and write() it again.
+//
+// File layout, sections are arrays of uint32_t unless noted:
+//   header
+//   starts[token_count], ends[token_count], names[token_count]
+//   attribute_begins[token_count + 1], matches[token_count]
+//   attributes[attribute_count] (attribute_entry)
+//   name_spans[name_count * 2] (start, size of a name in html)
+//   name_hashes[name_count], name_slots[slot_count]
+//   tag_offsets[tag_offset_count], tag_positions[tag_position_count]
+//   types[token_count], flags[token_count] (uint8_t)
+//
+class html_token_cache
+{
+public:
+    // "HTMLTOK" and format version
+    static const uint32_t version = 2;
+
+    struct header_type
+    {
+        char     magic[8];
+        uint32_t version;
+        uint32_t atom_count;
+        uint64_t atom_hash; // of atom names in order of their ids
+        uint64_t html_size;
+        uint64_t html_hash;
+        uint32_t token_count;
+        uint32_t attribute_count;
+        uint32_t name_count;
+        uint32_t slot_count;
+        uint32_t tag_offset_count;
+        uint32_t tag_position_count;
+    };
+
+    typedef html_token_store::attribute_entry attribute_entry;
+    typedef html_token_store::position_range  position_range;
+
+    // npos for not found
+    static const size_t npos = -1;
+
+private:
+    html_mapped_file  _file;
+    std::string_view  _html;
+    const header_type *_header;
+
+    // sections of mapped file
+    const uint32_t        *_starts;
+    const uint32_t        *_ends;
+    const uint32_t        *_names;
+    const uint32_t        *_attribute_begins;
+    const uint32_t        *_matches;
+    const attribute_entry *_attributes;
+    const uint32_t        *_name_spans;
+    const uint32_t        *_name_hashes;
+    const uint32_t        *_name_slots;
+    const uint32_t        *_tag_offsets;
+    const uint32_t        *_tag_positions;
+    const uint8_t         *_types;
+    const uint8_t         *_flags;
+
+    // file size of a header
+    static size_t get_file_size(const header_type &header);
+
+    // check that positions of sections are in the html and indexes are in
+    // their sections, return false if not
+    bool check_sections() const;
+
+public:
+    html_token_cache() : _header(nullptr) {}
+
+    // get cache path of a html file, the html path with ".tok" appended
+    static std::string get_path(const std::string &html_path)
+    {
+        return html_path + ".tok";
+    }
+
+    // write tables of a store of a whole html, the match table and the tag
+    // index are built if not yet. the file is written to path + ".tmp",
+    // synced and renamed to path, so a concurrent open() sees the old file
+    // or the whole new one. return false if the file cannot be written, or
+    // the store is of push mode and tokens were dropped.
+    static bool write(const std::string &path, const html_token_store &store);
+
+    // map a cache file of html, return false if it cannot be read or does
+    // not match html. html must outlive the cache.
+    bool open(const std::string &path, std::string_view html);
+
+    // unmap the file
+    void close();
+
+    bool is_open() const {return _header != nullptr;}
+
+    // get original html
+    std::string_view get_html() const {return _html;}
+
+    // return the number of tokens
+    size_t size() const {return _header ? _header->token_count : 0;}
+
+    // get columns of nth token, as html_token_store
+    html_token::token_type get_type(size_t pos) const
+    {
+        return (html_token::token_type)_types[pos];
+    }
+    uint8_t get_flags(size_t pos) const {return _flags[pos];}
+    size_t get_start_position(size_t pos) const {return _starts[pos];}
+    size_t get_end_position(size_t pos) const {return _ends[pos];}
+    uint32_t get_name_id(size_t pos) const {return _names[pos];}
+
+    // get attribute range [begin, end) of nth token in attribute table
+    size_t get_attribute_begin(size_t pos) const
+    {
+        return _attribute_begins[pos];
+    }
+    size_t get_attribute_end(size_t pos) const
+    {
+        return _attribute_begins[pos + 1];
+    }
+
+    // get an attribute in attribute table
+    const attribute_entry &get_attribute(size_t idx) const
+    {
+        return _attributes[idx];
+    }
+
+    // get name of a name id, known names are lower case, other names are
+    // spans of html as they first appear
+    std::string_view get_name(uint32_t name_id) const
+    {
+        if (name_id < atom_count) return html_atoms::get_name(name_id);
+
+        const uint32_t *span = _name_spans + (name_id - atom_count) * 2;
+        return get_span(span[0], span[1]);
+    }
+
+    // get name id of name, return no_name if it is neither known nor in html
+    uint32_t find_name_id(std::string_view name) const;
+
+    // get positions of start/end tags of a name id
+    position_range get_tag_positions(uint32_t name_id, bool start_tag) const
+    {
+        size_t key = (size_t)name_id * 2 + (start_tag ? 0 : 1);
+        if (name_id == html_token_store::no_name ||
+            key + 1 >= _header->tag_offset_count)
+        {
+            return {nullptr, nullptr};
+        }
+
+        return {_tag_positions + _tag_offsets[key],
+                _tag_positions + _tag_offsets[key + 1]};
+    }
+
+    // get a span of original html
+    std::string_view get_span(size_t start, size_t size) const
+    {
+        return size == 0 ? std::string_view() : _html.substr(start, size);
+    }
+
+    // queries of html_lexer on the mapped tables
+
+    // find tag by name, return npos if not found
+    size_t find_tag_by_name(std::string_view tag_name,
+                            bool start_tag,
+                            size_t pos) const;
+
+    // get positions of all start/end tags of a name
+    position_range find_all_tags_by_name(std::string_view tag_name,
+                                         bool start_tag) const
+    {
+        return get_tag_positions(find_name_id(tag_name), start_tag);
+    }
+
+    // find matching tag of nth tag
+    // return pos, if nth tag is self-closing tag or no match tag
+    // return position before pos, if nth tag is close tag
+    // return position after pos, if nth tag is start tag
+    size_t find_matching_tag(size_t pos) const;
+};
+
+#endif // __HTML_TOKEN_CACHE__
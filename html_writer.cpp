@@ -0,0 +1,285 @@
+#include <cerrno>   // errno
+#include <charconv> // to_chars()
+#include "html_writer.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h> // write()
+#define html_write_fd ::write
+#else
+#include <io.h>     // _write()
+#define html_write_fd ::_write
+#endif
+
+// append a decimal number
+static void append_number(std::string &output, size_t number)
+{
+    char digits[24];
+    auto result = std::to_chars(digits, digits + sizeof(digits), number);
+    output.append(digits, result.ptr - digits);
+}
+
+// get length of a valid utf-8 sequence of a lead byte >= 0x80, return 0 if
+// the sequence is invalid, overlong, a surrogate or above U+10FFFF
+static size_t utf8_length(std::string_view value, size_t pos)
+{
+    unsigned char c = value[pos];
+
+    // range of the second byte
+    unsigned char low = 0x80, high = 0xbf;
+    size_t length;
+    if (c >= 0xc2 && c <= 0xdf)
+    {
+        length = 2;
+    }
+    else if (c >= 0xe0 && c <= 0xef)
+    {
+        length = 3;
+        if (c == 0xe0) low  = 0xa0;
+        if (c == 0xed) high = 0x9f;
+    }
+    else if (c >= 0xf0 && c <= 0xf4)
+    {
+        length = 4;
+        if (c == 0xf0) low  = 0x90;
+        if (c == 0xf4) high = 0x8f;
+    }
+    else
+    {
+        return 0;
+    }
+
+    if (value.size() - pos < length) return 0;
+
+    unsigned char second = value[pos + 1];
+    if (second < low || second > high) return 0;
+    for (size_t i = 2; i < length; ++i)
+    {
+        if (((unsigned char)value[pos + i] & 0xc0) != 0x80) return 0;
+    }
+
+    return length;
+}
+
+// append a json string, runs without escaped characters are appended as
+// they are. html is not always utf-8, e.g. latin-1 or gbk pages, a byte of
+// an invalid sequence is replaced by U+FFFD so the json stays valid.
+static void append_json_string(std::string &output, std::string_view value)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    output += '"';
+
+    size_t run = 0;
+    for (size_t i = 0; i < value.size(); ++i)
+    {
+        unsigned char c = value[i];
+        if (c >= 0x20 && c < 0x80 && c != '"' && c != '\\') continue;
+
+        if (c >= 0x80)
+        {
+            size_t length = utf8_length(value, i);
+            if (length != 0)
+            {
+                i += length - 1;
+                continue;
+            }
+        }
+
+        output.append(value.data() + run, i - run);
+        run = i + 1;
+
+        switch (c)
+        {
+        case '"':  output += "\\\""; break;
+        case '\\': output += "\\\\"; break;
+        case '\n': output += "\\n";  break;
+        case '\r': output += "\\r";  break;
+        case '\t': output += "\\t";  break;
+        default:
+            if (c >= 0x80)
+            {
+                output += "\\ufffd";
+                break;
+            }
+            output += "\\u00";
+            output += hex[c >> 4];
+            output += hex[c & 0xf];
+            break;
+        }
+    }
+    output.append(value.data() + run, value.size() - run);
+
+    output += '"';
+}
+
+// append all tokens of a store
+void html_token_writer::write(const html_token_store &store)
+{
+    for (size_t pos = 0; pos < store.size(); ++pos)
+    {
+        write(store.get_token(pos));
+    }
+}
+
+// write buffer to the file descriptor, a short write or one interrupted by
+// a signal is continued
+bool html_token_writer::flush()
+{
+    if (_fd == no_fd) return !_failed;
+
+    const char *data = _buffer.data();
+    size_t size = _buffer.size();
+    while (size > 0 && !_failed)
+    {
+        auto written = html_write_fd(_fd, data, (unsigned)size);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0)
+        {
+            _failed = true;
+            break;
+        }
+
+        data += written;
+        size -= written;
+    }
+
+    _buffer.clear();
+    return !_failed;
+}
+
+// append a token to a string in format
+void html_token_writer::append(std::string &output, const html_token &token,
+                               format_type format)
+{
+    if (format == format_json_lines)
+    {
+        append_json(output, token);
+    }
+    else
+    {
+        append_text(output, token);
+    }
+}
+
+// append a token as html_token::print()
+void html_token_writer::append_text(std::string &output,
+                                    const html_token &token)
+{
+    const html_token_store *store = token._store;
+    size_t pos = token._pos;
+
+    switch (token.get_type())
+    {
+    case html_token::token_start_tag:
+        output += "[Start Tag      ] <";
+        output += store->get_name(store->get_name_id(pos));
+        for (size_t i = store->get_attribute_begin(pos),
+                    end = store->get_attribute_end(pos); i < end; ++i)
+        {
+            // lower case name, and value
+            auto &attribute = store->get_attribute(i);
+            output += ' ';
+            output += store->get_name(attribute.name_id);
+            if (attribute.value_size != 0)
+            {
+                output += "=\"";
+                output += store->get_span(attribute.value_start,
+                                          attribute.value_size);
+                output += '"';
+            }
+        }
+        if (token.get_self_closing())
+        {
+            output += '/';
+        }
+        output += ">\n";
+        break;
+    case html_token::token_end_tag:
+        output += "[End Tag        ] </";
+        output += store->get_name(store->get_name_id(pos));
+        output += ">\n";
+        break;
+    case html_token::token_comment:
+        output += "[Comment        ] <!--";
+        output += token.get_readonly_content();
+        output += "-->\n";
+        break;
+    case html_token::token_bogus_comment:
+        output += "[Bogus Comment  ] ";
+        output += token.get_readonly_content();
+        output += '\n';
+        break;
+    case html_token::token_text:
+        output += "[Text           ] ";
+        output += token.get_readonly_content();
+        output += '\n';
+        break;
+    case html_token::token_raw_text:
+        output += "[Raw Text       ] ";
+        output += token.get_readonly_content();
+        output += '\n';
+        break;
+    default:
+        break;
+    }
+}
+
+// append a token as a json object and a new line
+void html_token_writer::append_json(std::string &output,
+                                    const html_token &token)
+{
+    static const char *type_names[] = {
+        "null", "start_tag", "end_tag", "comment", "bogus_comment", "text",
+        "raw_text"
+    };
+
+    const html_token_store *store = token._store;
+    size_t pos = token._pos;
+    html_token::token_type type = token.get_type();
+
+    output += "{\"type\":\"";
+    output += type_names[type];
+    output += "\",\"start\":";
+    append_number(output, token.get_start_position());
+    output += ",\"end\":";
+    append_number(output, token.get_end_position());
+
+    switch (type)
+    {
+    case html_token::token_start_tag:
+        output += ",\"name\":";
+        append_json_string(output, store->get_name(store->get_name_id(pos)));
+        output += ",\"attributes\":[";
+        for (size_t i = store->get_attribute_begin(pos),
+                    begin = i, end = store->get_attribute_end(pos);
+             i < end; ++i)
+        {
+            auto &attribute = store->get_attribute(i);
+            if (i != begin) output += ',';
+            output += "{\"name\":";
+            append_json_string(output, store->get_name(attribute.name_id));
+            output += ",\"value\":";
+            append_json_string(output, store->get_span(attribute.value_start,
+                                                       attribute.value_size));
+            output += '}';
+        }
+        output += "],\"self_closing\":";
+        output += token.get_self_closing() ? "true" : "false";
+        break;
+    case html_token::token_end_tag:
+        output += ",\"name\":";
+        append_json_string(output, store->get_name(store->get_name_id(pos)));
+        break;
+    case html_token::token_comment:
+    case html_token::token_bogus_comment:
+    case html_token::token_text:
+    case html_token::token_raw_text:
+        output += ",\"content\":";
+        append_json_string(output, token.get_readonly_content());
+        break;
+    default:
+        break;
+    }
+
+    output += "}\n";
+}
@@ -0,0 +1,95 @@
+//
+// HTML Lexer - Token Writer
+// Buffered text and JSON Lines output of tokens
+//
+// Github - https://github.com/limingjie/HtmlLexer
+//
+#ifndef __HTML_WRITER__
+#define __HTML_WRITER__
+
+#include <cstddef> // size_t
+#include <string>
+#include <string_view>
+#include "html_lexer.hpp"
+
+//
+// html_token_writer - formats tokens into a reusable buffer.
+//
+// - Tokens are appended to the buffer, which is written to the file
+//   descriptor by a single write() once it holds capacity bytes, and by
+//   flush() or the destructor.
+// - format_text is the output of html_token::print(), format_json_lines
+//   writes an object per line, e.g.
+//   {"type":"start_tag","start":0,"end":19,"name":"a","attributes":
+//   [{"name":"href","value":"/"}],"self_closing":false}
+//   Strings are escaped, bytes of html are passed through as they are.
+// - With no_fd nothing is written, the buffer grows and keeps all output
+//   until clear().
+//
+class html_token_writer
+{
+public:
+    enum format_type
+    {
+        format_text,
+        format_json_lines
+    };
+
+    // file descriptor of standard output, and of no output
+    static const int stdout_fd = 1;
+    static const int no_fd     = -1;
+
+    static const size_t default_capacity = 1 << 20;
+
+private:
+    int         _fd;
+    format_type _format;
+    size_t      _capacity;
+    bool        _failed;
+    std::string _buffer;
+
+public:
+    explicit html_token_writer(int fd = stdout_fd,
+                               format_type format = format_text,
+                               size_t capacity = default_capacity) :
+        _fd(fd), _format(format), _capacity(capacity), _failed(false)
+    {
+        _buffer.reserve(capacity);
+    }
+    ~html_token_writer() {flush();}
+
+    // non-copyable, owns the buffer
+    html_token_writer(const html_token_writer &) = delete;
+    html_token_writer &operator=(const html_token_writer &) = delete;
+
+    void set_format(format_type format) {_format = format;}
+    format_type get_format() const {return _format;}
+
+    // append a token, or all tokens of a store
+    void write(const html_token &token)
+    {
+        append(_buffer, token, _format);
+        if (_buffer.size() >= _capacity) flush();
+    }
+    void write(const html_token_store &store);
+
+    // write buffer to the file descriptor, return false if write() failed
+    // now or before
+    bool flush();
+
+    // get buffered output, all output if no_fd
+    std::string_view view() const {return _buffer;}
+
+    // drop buffered output and keep memory
+    void clear() {_buffer.clear();}
+
+    // append a token to a string in format
+    static void append(std::string &output, const html_token &token,
+                       format_type format);
+
+private:
+    static void append_text(std::string &output, const html_token &token);
+    static void append_json(std::string &output, const html_token &token);
+};
+
+#endif // __HTML_WRITER__